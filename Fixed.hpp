@@ -9,6 +9,8 @@
 #include <random>
 #include <tuple>
 #include <algorithm>
+#include <bit>
+#include <concepts>
 #include "specialArr.hpp"
 
 namespace FluidPhysics {
@@ -32,37 +34,69 @@ namespace FluidPhysics {
     using real_t = realType<gridWidth, isFast>::type;
 
 
-    template<int gridWidth, int K, bool fast = false>
+    enum class FixedOverflow {
+        Wrap,     // results are truncated to value_t, as plain integer arithmetic would
+        Saturate, // results are clamped to the gridWidth-bit range, division by zero gives the extreme
+    };
+
+    template<int gridWidth, int K, bool fast = false, FixedOverflow overflow = FixedOverflow::Wrap>
     struct Fixed {
         static_assert(gridWidth > K, "gridWidth must be greater than K");
         using value_t = real_t<gridWidth, fast>;
+        // a.v * b.v needs 2 * gridWidth bits and a.v << K needs gridWidth + K; only the types
+        // that cannot fit them in 64 bits pay for the 128-bit intermediates
+        using mul_t = std::conditional_t<(2 * gridWidth > 64), __int128, int64_t>;
+        using div_t = std::conditional_t<(gridWidth + K > 64), __int128, int64_t>;
 
         constexpr static value_t scale = 1ll << K;
+        constexpr static bool saturating = overflow == FixedOverflow::Saturate;
+        constexpr static __int128 maxRaw = (static_cast<__int128>(1) << (gridWidth - 1)) - 1;
+        constexpr static __int128 minRaw = -maxRaw - 1;
         value_t v = 0;
 
         static const int k = K;
 
-        template<int otherN, int otherK, bool otherIsFast>
-        constexpr Fixed(const Fixed<otherN, otherK, otherIsFast> &other) {
-            if constexpr (otherK > K) {
+        template<int otherN, int otherK, bool otherIsFast, FixedOverflow otherOverflow>
+        constexpr Fixed(const Fixed<otherN, otherK, otherIsFast, otherOverflow> &other) {
+            if constexpr (saturating) {
+                if constexpr (otherK > K) {
+                    v = from_wide(static_cast<__int128>(other.v) >> (otherK - K)).v;
+                } else {
+                    v = from_wide(static_cast<__int128>(other.v) << (K - otherK)).v;
+                }
+            } else if constexpr (otherK > K) {
                 v = other.v >> (otherK - K);
             } else {
                 v = other.v << (K - otherK);
             }
         }
 
-
-        constexpr Fixed(int64_t v) : v(v << K) {}
-        constexpr Fixed(float f) : v(f * Fixed::scale) {}
-        constexpr Fixed(double f) : v(f * Fixed::scale) {}
+        template<std::integral I>
+        constexpr Fixed(I x) : v(from_wide(static_cast<__int128>(x) << K).v) {}
+        constexpr Fixed(float f) : Fixed(double(f)) {}
+        constexpr Fixed(double f) : v(from_double(f * Fixed::scale)) {}
         constexpr Fixed() : v(0) {}
 
-        static constexpr Fixed from_raw(int x) {
+        static constexpr Fixed from_raw(value_t x) {
             Fixed ret{};
             ret.v = x;
             return ret;
         }
 
+        // Raw value from a wider intermediate, truncated or clamped according to the policy
+        template<typename W>
+        static constexpr Fixed from_wide(W x) {
+            if constexpr (saturating) {
+                if (x > maxRaw) {
+                    return from_raw(value_t(maxRaw));
+                }
+                if (x < minRaw) {
+                    return from_raw(value_t(minRaw));
+                }
+            }
+            return from_raw(value_t(x));
+        }
+
         auto operator<=>(const Fixed &) const = default;
         bool operator==(const Fixed &) const = default;
 
@@ -70,19 +104,30 @@ namespace FluidPhysics {
         explicit constexpr operator double() { return double(v) / Fixed::scale; }
 
         friend Fixed operator+(Fixed a, Fixed b) {
+            if constexpr (saturating) {
+                return Fixed::from_wide(static_cast<mul_t>(a.v) + b.v);
+            }
             return Fixed::from_raw(a.v + b.v);
         }
 
         friend Fixed operator-(Fixed a, Fixed b) {
+            if constexpr (saturating) {
+                return Fixed::from_wide(static_cast<mul_t>(a.v) - b.v);
+            }
             return Fixed::from_raw(a.v - b.v);
         }
 
         friend Fixed operator*(Fixed a, Fixed b) {
-            return Fixed::from_raw((static_cast<int64_t>(a.v) * b.v) >> K);
+            return Fixed::from_wide((static_cast<mul_t>(a.v) * b.v) >> K);
         }
 
         friend Fixed operator/(Fixed a, Fixed b) {
-            return Fixed::from_raw((static_cast<int64_t>(a.v) << K) / b.v);
+            if constexpr (saturating) {
+                if (b.v == 0) {
+                    return Fixed::from_raw(value_t(a.v < 0 ? minRaw : a.v > 0 ? maxRaw : 0));
+                }
+            }
+            return Fixed::from_wide((static_cast<div_t>(a.v) << K) / b.v);
         }
 
         friend Fixed &operator+=(Fixed &a, Fixed b) {
@@ -102,18 +147,102 @@ namespace FluidPhysics {
         }
 
         friend Fixed operator-(Fixed x) {
+            if constexpr (saturating) {
+                return Fixed::from_wide(-static_cast<__int128>(x.v));
+            }
             return Fixed::from_raw(-x.v);
         }
 
         friend Fixed fabs(Fixed x) {
             if (x.v < 0) {
-                x.v = -x.v;
+                x = -x;
             }
             return x;
         }
 
         friend std::ostream &operator<<(std::ostream &out, Fixed x) {
-            return out << x.v / (double) (1 << K);
+            return out << x.v / double(Fixed::scale);
+        }
+
+    private:
+        static constexpr value_t from_double(double raw) {
+            if constexpr (saturating) {
+                if (raw >= double(maxRaw)) {
+                    return value_t(maxRaw);
+                }
+                if (raw <= double(minRaw)) {
+                    return value_t(minRaw);
+                }
+            }
+            return value_t(raw);
+        }
+    };
+
+    // (a * b) >> shift with a 128-bit intermediate, so neither the product nor the shift can overflow
+    constexpr uint64_t mul_shift(uint64_t a, uint64_t b, int shift) {
+        return uint64_t((static_cast<unsigned __int128>(a) * b) >> shift);
+    }
+
+    // Truncating division by a fixed positive divisor as shifts and one widening multiply.
+    // d = odd * 2^t; for odd > 1 with l = ceil(log2 odd), magic = ceil(2^(63 + l) / odd) fits in
+    // 64 bits and its rounding error is below 2^l, which keeps (u * magic) >> (63 + l) == u / odd
+    // for every u < 2^63.
+    struct IntReciprocal {
+        uint64_t magic = 0; // 0 when d is a power of two
+        int preShift = 0;
+        int postShift = 0;
+
+        constexpr IntReciprocal() = default;
+
+        explicit constexpr IntReciprocal(uint64_t d) {
+            assert(d > 0);
+            preShift = std::countr_zero(d);
+            uint64_t odd = d >> preShift;
+            if (odd > 1) {
+                postShift = std::bit_width(odd - 1) - 1;
+                magic = uint64_t((static_cast<unsigned __int128>(1) << (64 + postShift)) / odd) + 1;
+            }
+        }
+
+        constexpr int64_t divide(int64_t n) const {
+            uint64_t sign = uint64_t(n >> 63);
+            uint64_t u = ((uint64_t(n) ^ sign) - sign) >> preShift;
+            uint64_t q = magic ? mul_shift(u, magic, 64) >> postShift : u;
+            return int64_t((q ^ sign) - sign);
+        }
+    };
+
+    // x / d for a divisor fixed at init() time. Fixed division becomes a multiply by a precomputed
+    // reciprocal that gives exactly what operator/ gives; IEEE types keep the real division,
+    // since x * (1 / d) would round differently.
+    template<typename T>
+    struct Reciprocal {
+        T d{};
+
+        constexpr Reciprocal() = default;
+        explicit constexpr Reciprocal(T d) : d(d) {}
+
+        constexpr T divide(T x) const {
+            return x / d;
+        }
+    };
+
+    template<int N, int K, bool fast, FixedOverflow overflow>
+    struct Reciprocal<Fixed<N, K, fast, overflow>> {
+        using F = Fixed<N, K, fast, overflow>;
+        IntReciprocal r;
+        F d{};
+
+        constexpr Reciprocal() = default;
+        explicit constexpr Reciprocal(F d) : r(uint64_t(d.v)), d(d) {}
+
+        constexpr F divide(F x) const {
+            if constexpr (N + K > 64) {
+                // x.v << K does not fit the 64-bit reciprocal
+                return x / d;
+            } else {
+                return F::from_wide(r.divide(static_cast<int64_t>(x.v) << K));
+            }
         }
     };
 
@@ -0,0 +1,124 @@
+#ifndef FLUIDFINALVER_ACTIVEREGION_H
+#define FLUIDFINALVER_ACTIVEREGION_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace FluidPhysics {
+
+    // Dirty-tile tracking for skipping settled fluid. The grid is cut into tileSize x tileSize
+    // tiles; a tile is dirty when one of its cells changed by more than the epsilon during the
+    // last step, and a step only processes the dirty tiles and a one-tile halo around them.
+    // A tile that stays quiet falls asleep until a dirty neighbour wakes it up again.
+    class ActiveRegion {
+    public:
+        static constexpr int tileSize = 8;
+
+        // epsilon <= 0 turns tracking off and every step processes the whole grid
+        void setEpsilon(double epsilon) {
+            epsilon_ = epsilon;
+        }
+
+        double epsilon() const {
+            return epsilon_;
+        }
+
+        bool enabled() const {
+            return epsilon_ > 0;
+        }
+
+        // Every tile starts dirty, so the first step after init() covers the whole grid
+        void init(int n, int m) {
+            gridHeight_ = m;
+            tileRows_ = (n + tileSize - 1) / tileSize;
+            tileCols_ = (m + tileSize - 1) / tileSize;
+            dirty_.assign(size_t(tileRows_) * tileCols_, 1);
+            active_.assign(dirty_.size(), 0);
+            spans_.assign(tileRows_, {});
+        }
+
+        // Safe to call from the workers of the parallel movement phase
+        void markCell(int x, int y) {
+            std::atomic_ref<uint8_t>(dirty_[tileIndex(x / tileSize, y / tileSize)]).store(1, std::memory_order_relaxed);
+        }
+
+        // Turns the dirty tiles plus their halo into this step's active set and clears the dirty set
+        void beginStep() {
+            std::fill(active_.begin(), active_.end(), 0);
+            for (int tx = 0; tx < tileRows_; ++tx) {
+                for (int ty = 0; ty < tileCols_; ++ty) {
+                    if (!dirty_[tileIndex(tx, ty)]) {
+                        continue;
+                    }
+                    for (int ax = std::max(tx - 1, 0); ax <= std::min(tx + 1, tileRows_ - 1); ++ax) {
+                        for (int ay = std::max(ty - 1, 0); ay <= std::min(ty + 1, tileCols_ - 1); ++ay) {
+                            active_[tileIndex(ax, ay)] = 1;
+                        }
+                    }
+                }
+            }
+            std::fill(dirty_.begin(), dirty_.end(), 0);
+
+            size_t activeTiles = 0;
+            for (int tx = 0; tx < tileRows_; ++tx) {
+                auto &spans = spans_[tx];
+                spans.clear();
+                for (int ty = 0; ty < tileCols_; ++ty) {
+                    if (!active_[tileIndex(tx, ty)]) {
+                        continue;
+                    }
+                    ++activeTiles;
+                    int y0 = ty * tileSize, y1 = std::min(y0 + tileSize, gridHeight_);
+                    if (!spans.empty() && spans.back().second == y0) {
+                        spans.back().second = y1;
+                    } else {
+                        spans.emplace_back(y0, y1);
+                    }
+                }
+            }
+            ++steps_;
+            activeTileSum_ += activeTiles;
+            tileSum_ += active_.size();
+        }
+
+        bool cellActive(int x, int y) const {
+            return active_[tileIndex(x / tileSize, y / tileSize)];
+        }
+
+        // Active [y0, y1) ranges of row x, merged across neighbouring tiles
+        const std::vector<std::pair<int, int>> &spans(int x) const {
+            return spans_[x / tileSize];
+        }
+
+        // Share of tiles processed, averaged over all steps since tracking was enabled
+        double activeFraction() const {
+            return tileSum_ ? double(activeTileSum_) / double(tileSum_) : 1.0;
+        }
+
+        uint64_t trackedSteps() const {
+            return steps_;
+        }
+
+    private:
+        size_t tileIndex(int tx, int ty) const {
+            return size_t(tx) * tileCols_ + ty;
+        }
+
+        double epsilon_ = 0;
+        int gridHeight_ = 0;
+        int tileRows_ = 0;
+        int tileCols_ = 0;
+        std::vector<uint8_t> dirty_;
+        std::vector<uint8_t> active_;
+        std::vector<std::vector<std::pair<int, int>>> spans_;
+        uint64_t steps_ = 0;
+        uint64_t activeTileSum_ = 0;
+        uint64_t tileSum_ = 0;
+    };
+
+}
+
+#endif //FLUIDFINALVER_ACTIVEREGION_H
@@ -6,6 +6,7 @@
 #include <vector>
 #include <stdexcept>
 #include <cassert>
+#include <cstdint>
 
 #include "specialArr.hpp"
 
@@ -13,21 +14,133 @@ namespace FluidPhysics {
 
     constexpr std::array<std::pair<int, int>, 4> deltas{{{-1, 0}, {1, 0}, {0, -1}, {0, 1}}};
 
+    // Direction indices into deltas; opposite directions differ only in the lowest bit
+    enum Dir : size_t {
+        Up = 0,
+        Down = 1,
+        Left = 2,
+        Right = 3,
+    };
+
+    constexpr size_t opposite(size_t dir) {
+        return dir ^ 1;
+    }
+
+    constexpr uint8_t dirBit(size_t dir) {
+        return uint8_t(1u << dir);
+    }
+
+    constexpr size_t dirIndex(int dx, int dy) {
+        return dx != 0 ? size_t(dx + 1) / 2 : 2 + size_t(dy + 1) / 2;
+    }
+
+    static_assert(dirIndex(-1, 0) == Up && dirIndex(1, 0) == Down && dirIndex(0, -1) == Left && dirIndex(0, 1) == Right);
+    static_assert(deltas[opposite(Up)] == std::pair(1, 0) && deltas[opposite(Left)] == std::pair(0, 1));
+
     template<typename T>
     T g() { return 0.1; }
 
-    template<typename T, int gridWidth, int gridHeight>
+    enum class FieldLayout {
+        AoS, // one std::array<T, 4> per cell
+        SoA, // four direction planes, each a contiguous grid
+    };
+
+    template<typename T, int gridWidth, int gridHeight, FieldLayout Layout = FieldLayout::AoS>
     struct VectorField {
         Array <std::array<T, deltas.size()>, gridWidth, gridHeight> v;
+        // distance in T between the same direction of neighbouring cells in a row
+        static constexpr ptrdiff_t cellStride = deltas.size();
+
+        void init(int n, int m) {
+            v.init(n, m);
+        }
+
+        size_t heapBytes() const {
+            return v.heapBytes();
+        }
+
+        void clear() {
+            v.fill({});
+        }
 
         T &add(int x, int y, int dx, int dy, T dv) {
             return get(x, y, dx, dy) += dv;
         }
 
+        T &add(int x, int y, size_t dir, T dv) {
+            return get(x, y, dir) += dv;
+        }
+
         T &get(int x, int y, int dx, int dy) {
-            size_t i = std::ranges::find(deltas, std::pair(dx, dy)) - deltas.begin();
-            assert(i < deltas.size());
-            return v[x][y][i];
+            assert(std::ranges::find(deltas, std::pair(dx, dy)) != deltas.end());
+            return get(x, y, dirIndex(dx, dy));
+        }
+
+        T &get(int x, int y, size_t dir) {
+            return v[x][y][dir];
+        }
+
+        template<Dir D>
+        T &get(int x, int y) {
+            return v[x][y][D];
+        }
+
+        void swapCells(int x1, int y1, int x2, int y2) {
+            std::swap(v[x1][y1], v[x2][y2]);
+        }
+    };
+
+    template<typename T, int gridWidth, int gridHeight>
+    struct VectorField<T, gridWidth, gridHeight, FieldLayout::SoA> {
+        std::array<Array<T, gridWidth, gridHeight>, deltas.size()> planes;
+        static constexpr ptrdiff_t cellStride = 1;
+
+        void init(int n, int m) {
+            for (auto &plane : planes) {
+                plane.init(n, m);
+            }
+        }
+
+        size_t heapBytes() const {
+            size_t bytes = 0;
+            for (auto &plane : planes) {
+                bytes += plane.heapBytes();
+            }
+            return bytes;
+        }
+
+        void clear() {
+            for (auto &plane : planes) {
+                plane.fill({});
+            }
+        }
+
+        T &add(int x, int y, int dx, int dy, T dv) {
+            return get(x, y, dx, dy) += dv;
+        }
+
+        T &add(int x, int y, size_t dir, T dv) {
+            return get(x, y, dir) += dv;
+        }
+
+        T &get(int x, int y, int dx, int dy) {
+            assert(std::ranges::find(deltas, std::pair(dx, dy)) != deltas.end());
+            return get(x, y, dirIndex(dx, dy));
+        }
+
+        T &get(int x, int y, size_t dir) {
+            return planes[dir][x][y];
+        }
+
+        template<Dir D>
+        T &get(int x, int y) {
+            return planes[D][x][y];
+        }
+
+        void swapCells(int x1, int y1, int x2, int y2) {
+            for (auto &plane : planes) {
+                std::swap(plane[x1][y1], plane[x2][y2]);
+            }
         }
     };
 
@@ -0,0 +1,128 @@
+#ifndef FLUIDFINALVER_AUTOTUNE_H
+#define FLUIDFINALVER_AUTOTUNE_H
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "generatorFactory.hpp"
+
+namespace FluidPhysics {
+
+    struct AutoTuneSettings {
+        // Calibration steps every compiled-in type combination runs
+        int steps = 20;
+        // Largest divergence from the DOUBLE reference a combination may have
+        double tolerance = 0.05;
+    };
+
+    // The chosen combination, its engine after the calibration steps and how many steps it ran
+    struct AutoTuneResult {
+        int pType = 0;
+        int vType = 0;
+        int vFlowType = 0;
+        int steps = 0;
+        std::shared_ptr<IEngine> engine;
+    };
+
+    // Share of cells whose contents differ, or the RMS pressure error relative to the RMS
+    // reference pressure, whichever is larger. Both frames hold RecordGrid | RecordPressure.
+    inline double frameDivergence(const FrameLayout &refLayout, const std::vector<char> &ref,
+                                  const FrameLayout &layout, const std::vector<char> &frame) {
+        const size_t cells = size_t(layout.width) * layout.height;
+        const uint32_t fields = RecordGrid | RecordPressure;
+        size_t mismatched = 0;
+        for (size_t i = 0; i < cells; ++i) {
+            mismatched += ref[i] != frame[i];
+        }
+        const char *refPressure = ref.data() + refLayout.fieldOffset(fields, RecordPressure);
+        const char *pressure = frame.data() + layout.fieldOffset(fields, RecordPressure);
+        double errorSum = 0, refSum = 0;
+        for (size_t i = 0; i < cells; ++i) {
+            double expected = rawToDouble(refLayout.pTypeCode, refLayout.pSize, refPressure + i * refLayout.pSize);
+            double actual = rawToDouble(layout.pTypeCode, layout.pSize, pressure + i * layout.pSize);
+            errorSum += (actual - expected) * (actual - expected);
+            refSum += expected * expected;
+        }
+        const double pressureError = std::sqrt(refSum > 0 ? errorSum / refSum : errorSum);
+        return std::max(cells ? double(mismatched) / double(cells) : 0.0, std::isnan(pressureError) ? INFINITY : pressureError);
+    }
+
+    // Runs settings.steps steps of the scene at path on every (p, v, v-flow) type combination
+    // compiled in, DOUBLE/DOUBLE/DOUBLE first as the reference, and returns the engine of the one
+    // with the most steps per second among those within settings.tolerance of the reference.
+    // configure(IEngine&) applies the run's settings to each engine before it steps; a line per
+    // combination goes to report.
+    template<typename Configure>
+    AutoTuneResult autoTune(const std::string &path, const AutoTuneSettings &settings, Configure &&configure,
+                            std::ostream &report) {
+        if (settings.steps <= 0) {
+            throw std::invalid_argument("Auto-tune needs a positive number of calibration steps");
+        }
+        if (findCombo({DOUBLE, DOUBLE, DOUBLE, -1, -1}) == noCombo) {
+            throw std::invalid_argument("Auto-tune needs DOUBLE in DTYPES for its reference");
+        }
+        const std::tuple reference(DOUBLE, DOUBLE, DOUBLE);
+        std::vector<std::tuple<int, int, int>> candidates{reference};
+        for (size_t idx : comboOrder) {
+            auto [pType, vType, vfType, n, m] = allCombos[idx];
+            std::tuple types(pType, vType, vfType);
+            if (types != candidates.back() && types != reference) {
+                candidates.push_back(types);
+            }
+        }
+
+        const uint32_t fields = RecordGrid | RecordPressure;
+        FrameLayout refLayout;
+        std::vector<char> refFrame, frame;
+        AutoTuneResult best;
+        double bestRate = 0;
+        for (const auto &[pType, vType, vfType] : candidates) {
+            report << "auto-tune " << GetTypeName(pType) << ", " << GetTypeName(vType) << ", "
+                   << GetTypeName(vfType) << ": ";
+            try {
+                auto engine = LoadEngine(path, pType, vType, vfType);
+                configure(*engine);
+                const auto startTime = std::chrono::steady_clock::now();
+                for (int i = 0; i < settings.steps; ++i) {
+                    engine->next(std::nullopt);
+                }
+                const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+                const double rate = elapsed.count() > 0 ? settings.steps / elapsed.count() : INFINITY;
+
+                double divergence = 0;
+                if (refFrame.empty()) {
+                    refLayout = engine->frameLayout();
+                    engine->captureFrame(fields, refFrame);
+                } else {
+                    engine->captureFrame(fields, frame);
+                    divergence = frameDivergence(refLayout, refFrame, engine->frameLayout(), frame);
+                }
+                const bool accepted = divergence <= settings.tolerance;
+                report << std::fixed << std::setprecision(1) << rate << " steps/s, divergence "
+                       << std::defaultfloat << std::setprecision(3) << divergence << (accepted ? "" : " (rejected)")
+                       << std::setprecision(6) << "\n";
+                if (accepted && rate > bestRate) {
+                    bestRate = rate;
+                    best = AutoTuneResult{pType, vType, vfType, settings.steps, std::move(engine)};
+                }
+            } catch (const std::exception &ex) {
+                report << "FAILED: " << ex.what() << "\n";
+                if (refFrame.empty()) {
+                    throw;
+                }
+            }
+        }
+        report << "auto-tune picked " << GetTypeName(best.pType) << ", " << GetTypeName(best.vType) << ", "
+               << GetTypeName(best.vFlowType) << " out of " << candidates.size() << " combinations" << std::endl;
+        return best;
+    }
+
+}
+
+#endif //FLUIDFINALVER_AUTOTUNE_H
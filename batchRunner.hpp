@@ -0,0 +1,188 @@
+#ifndef FLUIDFINALVER_BATCHRUNNER_H
+#define FLUIDFINALVER_BATCHRUNNER_H
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "enginePool.hpp"
+#include "workStealingPool.hpp"
+
+namespace FluidPhysics {
+
+    // One line of a batch manifest: "input output p-type v-type v-flow-type steps".
+    // Relative paths are taken relative to the manifest's directory.
+    struct BatchJob {
+        std::string input;
+        std::string output;
+        int pType = 0;
+        int vType = 0;
+        int vFlowType = 0;
+        int steps = 0;
+    };
+
+    // Settings shared by every job of a batch
+    struct BatchSettings {
+        int threads = 1;
+        FlowSolverKind flowSolver = FlowSolverKind::Dfs;
+        KernelPath kernelPath = KernelPath::Auto;
+        RngKind rngKind = RngKind::Mt19937;
+        uint64_t seed = EngineRandom::defaultSeed;
+        CheckpointFormat saveFormat = CheckpointFormat::Binary;
+        double activeEpsilon = 0;
+    };
+
+    struct BatchResult {
+        bool ok = false;
+        std::string error;
+        int width = 0;
+        int height = 0;
+        double seconds = 0;
+        size_t memory = 0;
+    };
+
+    inline std::vector<BatchJob> readBatchManifest(const std::string &path) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open batch manifest: " + path);
+        }
+        const auto base = std::filesystem::path(path).parent_path();
+        auto resolve = [&](const std::string &name) {
+            std::filesystem::path p(name);
+            return (p.is_relative() ? base / p : p).string();
+        };
+
+        std::vector<BatchJob> jobs;
+        std::string line;
+        for (int lineNo = 1; std::getline(file, line); ++lineNo) {
+            line = line.substr(0, line.find('#'));
+            std::istringstream fields(line);
+            std::string input, output, pType, vType, vFlowType;
+            if (!(fields >> input)) {
+                continue;
+            }
+            BatchJob job;
+            if (!(fields >> output >> pType >> vType >> vFlowType >> job.steps) || job.steps < 0) {
+                throw std::invalid_argument("Malformed batch manifest line " + std::to_string(lineNo) + " in " + path);
+            }
+            job.input = resolve(input);
+            job.output = resolve(output);
+            job.pType = GetTypeCode(pType);
+            job.vType = GetTypeCode(vType);
+            job.vFlowType = GetTypeCode(vFlowType);
+            jobs.push_back(std::move(job));
+        }
+        return jobs;
+    }
+
+    // Loads, runs and saves one job on the calling thread; the engine itself stays single-threaded
+    inline BatchResult runBatchJob(const BatchJob &job, const BatchSettings &settings, EnginePool &engines) {
+        BatchResult result;
+        try {
+            const auto engine = engines.load(job.input, job.pType, job.vType, job.vFlowType);
+            engine->setThreadCount(1);
+            engine->setFlowSolver(settings.flowSolver);
+            engine->setKernelPath(settings.kernelPath);
+            engine->setRandom(settings.rngKind, settings.seed);
+            engine->setActiveEpsilon(settings.activeEpsilon);
+            engine->setFrameMode(FrameMode::None, 1);
+
+            const auto startTime = std::chrono::steady_clock::now();
+            for (int i = 0; i < job.steps; ++i) {
+                engine->next(std::nullopt);
+            }
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+            std::ofstream out(job.output, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                throw std::runtime_error("Failed to open output file: " + job.output);
+            }
+            if (settings.saveFormat == CheckpointFormat::Text) {
+                engine->save(out);
+            } else {
+                engine->saveBinary(out);
+            }
+
+            std::tie(result.width, result.height) = engine->gridSize();
+            result.seconds = elapsed.count();
+            result.memory = engine->memoryUsage();
+            result.ok = true;
+        } catch (const std::exception &ex) {
+            result.error = ex.what();
+        }
+        return result;
+    }
+
+    inline long peakResidentKiB() {
+#ifndef _WIN32
+        rusage usage{};
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+            return usage.ru_maxrss;
+        }
+#endif
+        return 0;
+    }
+
+    // Runs every job of the manifest on a work-stealing pool of settings.threads workers, one job
+    // per worker at a time, and prints a line per job. Returns the number of failed jobs.
+    inline int runBatch(const std::vector<BatchJob> &jobs, const BatchSettings &settings, std::ostream &report) {
+        std::vector<BatchResult> results(jobs.size());
+        // Jobs of the same types and size take over the engine of a finished one
+        EnginePool engines;
+        const auto startTime = std::chrono::steady_clock::now();
+        {
+            WorkStealingPool pool(settings.threads);
+            // Longest first, so a long job picked up last does not leave the tail to a single worker
+            std::vector<size_t> order(jobs.size());
+            for (size_t i = 0; i < order.size(); ++i) {
+                order[i] = i;
+            }
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                return jobs[a].steps > jobs[b].steps;
+            });
+            for (size_t i : order) {
+                pool.submit([&, i] { results[i] = runBatchJob(jobs[i], settings, engines); });
+            }
+            pool.wait();
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+        int failed = 0;
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            const auto &job = jobs[i];
+            const auto &res = results[i];
+            report << "job " << i + 1 << " " << job.input << " -> " << job.output << " ["
+                   << GetTypeName(job.pType) << ", " << GetTypeName(job.vType) << ", "
+                   << GetTypeName(job.vFlowType) << "]: ";
+            if (!res.ok) {
+                ++failed;
+                report << "FAILED: " << res.error << "\n";
+                continue;
+            }
+            const double cellSteps = double(res.width) * res.height * job.steps;
+            report << job.steps << " steps on " << res.width << "x" << res.height << " in "
+                   << std::fixed << std::setprecision(3) << res.seconds << " s, "
+                   << std::setprecision(1) << (res.seconds > 0 ? job.steps / res.seconds : 0.0) << " steps/s, "
+                   << (cellSteps > 0 ? res.seconds * 1e9 / cellSteps : 0.0) << " ns/cell/step, "
+                   << res.memory / 1024 << " KiB\n";
+        }
+        report << jobs.size() - failed << "/" << jobs.size() << " jobs done on " << settings.threads
+               << " threads with " << engines.created() << " engines in " << std::fixed << std::setprecision(3) << elapsed.count() << " s, peak RSS "
+               << peakResidentKiB() << " KiB" << std::defaultfloat << std::setprecision(6) << std::endl;
+        return failed;
+    }
+
+}
+
+#endif //FLUIDFINALVER_BATCHRUNNER_H
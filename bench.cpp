@@ -0,0 +1,200 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <random>
+#include <thread>
+#include <iomanip>
+#include <set>
+
+#include "generatorFactory.hpp"
+
+namespace fs = std::filesystem;
+
+// Sweeps every engine compiled in through DTYPES / DSIZES over fixed seeded scenes.
+// Each size in DSIZES is run on its static engine and on the dynamic (-1, -1) one.
+
+struct Scenario {
+    int width;
+    int height;
+    fs::path path;
+};
+
+struct BenchResult {
+    std::string name;
+    int pType, vType, vFlowType;
+    int width, height;
+    bool dynamic;
+    int steps;
+    double seconds;
+};
+
+// Walled box with a pool of fluid at the bottom, a floating blob and a few seeded obstacles
+Scenario MakeScenario(int n, int m, unsigned seed, const fs::path& dir) {
+    std::mt19937 gen(seed);
+    std::vector<std::string> grid(n, std::string(m, ' '));
+    for (int x = 0; x < n; ++x) {
+        for (int y = 0; y < m; ++y) {
+            if (x == 0 || y == 0 || x == n - 1 || y == m - 1) {
+                grid[x][y] = '#';
+            } else if (x >= n * 2 / 3) {
+                grid[x][y] = '.';
+            }
+        }
+    }
+    std::uniform_int_distribution<int> rx(1, std::max(1, n - 2)), ry(1, std::max(1, m - 2));
+    int bx = rx(gen) / 2 + 1, by = ry(gen);
+    for (int x = bx; x < std::min(n - 1, bx + n / 6 + 1); ++x) {
+        for (int y = by; y < std::min(m - 1, by + m / 8 + 1); ++y) {
+            grid[x][y] = '.';
+        }
+    }
+    for (int i = 0; i < (n + m) / 8; ++i) {
+        grid[rx(gen)][ry(gen)] = '#';
+    }
+
+    Scenario scenario{n, m, dir / ("fluid_bench_" + std::to_string(n) + "x" + std::to_string(m) + ".txt")};
+    std::ofstream out(scenario.path);
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to write scenario " + scenario.path.string());
+    }
+    out << n << " " << m << " 0\n";
+    for (const auto& row : grid) {
+        out << row << "\n";
+    }
+    return scenario;
+}
+
+std::string JsonEscape(const std::string& s) {
+    std::string res;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            res += '\\';
+        }
+        res += c;
+    }
+    return res;
+}
+
+void WriteJson(std::ostream& out, const std::vector<BenchResult>& results, int steps, int threads,
+               FluidPhysics::FlowSolverKind flowSolver) {
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+    out << "{\n  \"context\": {\n"
+        << "    \"date\": \"" << date << "\",\n"
+        << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+        << "    \"steps\": " << steps << ",\n"
+        << "    \"threads\": " << threads << ",\n"
+        << "    \"flow_solver\": \"" << (flowSolver == FluidPhysics::FlowSolverKind::Dfs ? "dfs" : "blocking") << "\"\n"
+        << "  },\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        double ns = r.seconds * 1e9;
+        out << (i ? ",\n" : "\n")
+            << "    {\"name\": \"" << JsonEscape(r.name) << "\""
+            << ", \"p_type\": \"" << GetTypeName(r.pType) << "\""
+            << ", \"v_type\": \"" << GetTypeName(r.vType) << "\""
+            << ", \"v_flow_type\": \"" << GetTypeName(r.vFlowType) << "\""
+            << ", \"width\": " << r.width << ", \"height\": " << r.height
+            << ", \"engine\": \"" << (r.dynamic ? "dynamic" : "static") << "\""
+            << ", \"steps\": " << r.steps
+            << ", \"real_time_ns\": " << ns
+            << ", \"ns_per_cell_step\": " << ns / r.steps / (double(r.width) * r.height)
+            << ", \"steps_per_second\": " << r.steps / r.seconds << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+int main(int argc, char* argv[]) {
+    OptionsParser optsParser(argc, argv);
+    const int steps = optsParser.hasOpt("--steps") ? optsParser.getOptValAsInt("--steps") : 100;
+    const int warmup = optsParser.hasOpt("--warmup") ? optsParser.getOptValAsInt("--warmup") : 5;
+    const int threads = optsParser.hasOpt("--threads") ? optsParser.getOptValAsInt("--threads") : 1;
+    const auto flowSolver = optsParser.hasOpt("--flow-solver")
+            ? GetFlowSolverKind(optsParser.getOptVal("--flow-solver"))
+            : FluidPhysics::FlowSolverKind::Dfs;
+    const auto kernelPath = optsParser.hasOpt("--kernels")
+            ? GetKernelPath(optsParser.getOptVal("--kernels"))
+            : FluidPhysics::KernelPath::Auto;
+    const auto rngKind = optsParser.hasOpt("--rng")
+            ? GetRngKind(optsParser.getOptVal("--rng"))
+            : FluidPhysics::RngKind::Mt19937;
+    const std::string filter = optsParser.hasOpt("--filter") ? optsParser.getOptVal("--filter") : "";
+    const unsigned seed = optsParser.hasOpt("--seed") ? optsParser.getOptValAsInt("--seed") : 1337;
+    if (steps <= 0 || warmup < 0) {
+        throw std::invalid_argument("Step counts must be positive");
+    }
+
+    const fs::path dir = fs::temp_directory_path();
+    std::vector<Scenario> scenarios;
+    for (auto [n, m] : {DSIZES}) {
+        if (n > 0 && m > 0) {
+            scenarios.push_back(MakeScenario(n, m, seed, dir));
+        }
+    }
+    if (optsParser.hasOpt("--size")) {
+        auto [n, m] = optsParser.getOptValAsPair("--size");
+        scenarios.push_back(MakeScenario(n, m, seed, dir));
+    }
+
+    std::vector<BenchResult> results;
+    std::set<std::string> seen;
+    std::cout << std::left << std::setw(56) << "benchmark" << std::right << std::setw(14) << "ms/step"
+              << std::setw(16) << "ns/cell/step" << std::setw(12) << "steps/s" << std::endl;
+    for (const auto& scenario : scenarios) {
+        for (size_t idx = 0; idx < FluidPhysics::allCombos.size(); ++idx) {
+            auto [pType, vType, vFlowType, n, m] = FluidPhysics::allCombos[idx];
+            bool dynamic = n == -1;
+            if (!dynamic && (n != scenario.width || m != scenario.height)) {
+                continue;
+            }
+            std::string name = GetTypeName(pType) + "/" + GetTypeName(vType) + "/" + GetTypeName(vFlowType) + "/" +
+                               std::to_string(scenario.width) + "x" + std::to_string(scenario.height) +
+                               (dynamic ? "/dynamic" : "/static");
+            if (name.find(filter) == std::string::npos || !seen.insert(name).second) {
+                continue;
+            }
+
+            auto engine = FluidPhysics::engineFactory(idx)();
+            engine->load(FluidPhysics::MappedFile(scenario.path));
+            engine->setThreadCount(threads);
+            engine->setFlowSolver(flowSolver);
+            engine->setKernelPath(kernelPath);
+            engine->setRandom(rngKind, seed);
+            for (int i = 0; i < warmup; ++i) {
+                engine->next(std::nullopt);
+            }
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < steps; ++i) {
+                engine->next(std::nullopt);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            results.push_back({name, pType, vType, vFlowType, scenario.width, scenario.height, dynamic, steps,
+                               elapsed.count()});
+            double ns = elapsed.count() * 1e9;
+            std::cout << std::left << std::setw(56) << name << std::right << std::fixed
+                      << std::setprecision(3) << std::setw(14) << ns / 1e6 / steps
+                      << std::setw(16) << ns / steps / (double(scenario.width) * scenario.height)
+                      << std::setprecision(1) << std::setw(12) << steps / elapsed.count() << std::endl;
+        }
+    }
+
+    for (const auto& scenario : scenarios) {
+        std::error_code ec;
+        fs::remove(scenario.path, ec);
+    }
+
+    if (optsParser.hasOpt("--json")) {
+        std::ofstream json(optsParser.getOptVal("--json"));
+        if (!json.is_open()) {
+            throw std::runtime_error("Failed to open " + optsParser.getOptVal("--json"));
+        }
+        WriteJson(json, results, steps, threads, flowSolver);
+    }
+    return 0;
+}
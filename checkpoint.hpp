@@ -0,0 +1,239 @@
+#ifndef FLUIDFINALVER_CHECKPOINT_H
+#define FLUIDFINALVER_CHECKPOINT_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include <fstream>
+
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Fixed.hpp"
+
+namespace FluidPhysics {
+
+    enum class CheckpointFormat {
+        Text,
+        Binary,
+    };
+
+    // Same encoding as the FLOAT / DOUBLE / FIXED / FAST_FIXED / SAT_FIXED macros in types.hpp
+    template<typename T>
+    struct TypeCode;
+
+    template<>
+    struct TypeCode<float> {
+        static constexpr int value = 1;
+    };
+
+    template<>
+    struct TypeCode<double> {
+        static constexpr int value = 2;
+    };
+
+    template<int N, int K, bool fast>
+    struct TypeCode<Fixed<N, K, fast>> {
+        static constexpr int value = fast ? N * 100000 + K : N * 1000 + K;
+    };
+
+    template<int N, int K>
+    struct TypeCode<Fixed<N, K, false, FixedOverflow::Saturate>> {
+        static constexpr int value = N * 10000000 + K;
+    };
+
+    template<typename T>
+    constexpr int typeCodeOf = TypeCode<T>::value;
+
+    constexpr char checkpointMagic[8] = {'F', 'L', 'U', 'I', 'D', 'C', 'K', 'P'};
+    constexpr uint32_t checkpointVersion = 1;
+
+    // Binary checkpoint layout, native byte order:
+    //   header, then width * height cells of each section in row-major order:
+    //   grid (char), lastUsage (int32), pressure (raw P), velocity (4 raw V per cell in deltas order)
+    struct CheckpointHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        int32_t width;
+        int32_t height;
+        int32_t pTypeCode;
+        int32_t vTypeCode;
+        int32_t vFlowTypeCode;
+        uint32_t pSize;
+        uint32_t vSize;
+        int32_t updateTimestamp;
+        int64_t createdAt;
+
+        size_t payloadSize() const {
+            size_t cells = size_t(width) * height;
+            return cells * (sizeof(char) + sizeof(int32_t) + pSize + 4 * size_t(vSize));
+        }
+    };
+
+    static_assert(std::is_trivially_copyable_v<CheckpointHeader> && sizeof(CheckpointHeader) == 56);
+
+    template<typename P, typename V, typename VFlow>
+    CheckpointHeader makeCheckpointHeader(int width, int height, int updateTimestamp) {
+        CheckpointHeader header{};
+        std::memcpy(header.magic, checkpointMagic, sizeof(checkpointMagic));
+        header.version = checkpointVersion;
+        header.headerSize = sizeof(CheckpointHeader);
+        header.width = width;
+        header.height = height;
+        header.pTypeCode = typeCodeOf<P>;
+        header.vTypeCode = typeCodeOf<V>;
+        header.vFlowTypeCode = typeCodeOf<VFlow>;
+        header.pSize = sizeof(P);
+        header.vSize = sizeof(V);
+        header.updateTimestamp = updateTimestamp;
+        header.createdAt = static_cast<int64_t>(std::time(nullptr));
+        return header;
+    }
+
+    // Read-only view of a whole file, mapped with mmap where available
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string &path) {
+#ifdef _WIN32
+            std::ifstream file(path, std::ios::binary);
+            if (!file.is_open()) {
+                throw std::runtime_error("Failed to open file: " + path);
+            }
+            buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            data_ = buffer_.data();
+            size_ = buffer_.size();
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw std::runtime_error("Failed to open file: " + path);
+            }
+            struct stat st{};
+            if (::fstat(fd, &st) != 0) {
+                ::close(fd);
+                throw std::runtime_error("Failed to stat file: " + path);
+            }
+            size_ = static_cast<size_t>(st.st_size);
+            if (size_ > 0) {
+                void *mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped == MAP_FAILED) {
+                    ::close(fd);
+                    throw std::runtime_error("Failed to map file: " + path);
+                }
+                ::madvise(mapped, size_, MADV_SEQUENTIAL);
+                data_ = static_cast<const char *>(mapped);
+            }
+            ::close(fd);
+#endif
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        ~MappedFile() {
+#ifndef _WIN32
+            if (data_ != nullptr) {
+                ::munmap(const_cast<char *>(data_), size_);
+            }
+#endif
+        }
+
+        const char *data() const { return data_; }
+        size_t size() const { return size_; }
+
+    private:
+        const char *data_ = nullptr;
+        size_t size_ = 0;
+#ifdef _WIN32
+        std::vector<char> buffer_;
+#endif
+    };
+
+    // Single forward pass over a text checkpoint in memory. Grid cells are single characters
+    // (a newline is never a cell), everything else is whitespace-separated numbers.
+    class TextScanner {
+    public:
+        explicit TextScanner(const MappedFile &file) : pos_(file.data()), end_(file.data() + file.size()) {}
+
+        // Copies the next count cells to dst, a whole row at once when it has no line break inside
+        void cells(char *dst, int count) {
+            while (count > 0) {
+                while (pos_ != end_ && *pos_ == '\n') {
+                    ++pos_;
+                }
+                if (end_ - pos_ < 1) {
+                    throw std::runtime_error("Unexpected end of text checkpoint");
+                }
+                const char *stop = pos_ + std::min<ptrdiff_t>(count, end_ - pos_);
+                const void *lineEnd = std::memchr(pos_, '\n', size_t(stop - pos_));
+                if (lineEnd != nullptr) {
+                    stop = static_cast<const char *>(lineEnd);
+                }
+                std::memcpy(dst, pos_, size_t(stop - pos_));
+                dst += stop - pos_;
+                count -= int(stop - pos_);
+                pos_ = stop;
+            }
+        }
+
+        template<typename T>
+        T number() {
+            while (pos_ != end_ && (*pos_ == ' ' || (*pos_ >= '\t' && *pos_ <= '\r'))) {
+                ++pos_;
+            }
+            T value{};
+            if (pos_ == end_) {
+                // Scene files may stop after the grid; the sections they leave out start at zero
+                return value;
+            }
+            auto [ptr, ec] = std::from_chars(pos_, end_, value);
+            if (ec != std::errc()) {
+                throw std::runtime_error("Malformed number in text checkpoint");
+            }
+            pos_ = ptr;
+            return value;
+        }
+
+    private:
+        const char *pos_;
+        const char *end_;
+    };
+
+    inline bool isBinaryCheckpoint(const MappedFile &file) {
+        return file.size() >= sizeof(checkpointMagic) &&
+               std::memcmp(file.data(), checkpointMagic, sizeof(checkpointMagic)) == 0;
+    }
+
+    inline CheckpointHeader readCheckpointHeader(const MappedFile &file) {
+        if (!isBinaryCheckpoint(file) || file.size() < sizeof(CheckpointHeader)) {
+            throw std::runtime_error("Not a binary checkpoint");
+        }
+        CheckpointHeader header{};
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (header.version != checkpointVersion || header.headerSize != sizeof(CheckpointHeader)) {
+            throw std::runtime_error("Unsupported checkpoint version " + std::to_string(header.version));
+        }
+        if (header.width <= 0 || header.height <= 0 ||
+            file.size() - sizeof(CheckpointHeader) < header.payloadSize()) {
+            throw std::runtime_error("Truncated checkpoint");
+        }
+        return header;
+    }
+
+}
+
+#endif //FLUIDFINALVER_CHECKPOINT_H
@@ -0,0 +1,103 @@
+#ifndef FLUIDFINALVER_ENGINEPOOL_H
+#define FLUIDFINALVER_ENGINEPOOL_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "generatorFactory.hpp"
+
+namespace FluidPhysics {
+
+    // Keeps released engines per (p-type, v-type, v-flow-type, n, m) and hands them out again
+    // after reset(), so the grids of a static engine are allocated and zeroed only once and a
+    // dynamic engine reloads into the storage it already has. The pool must outlive its handles.
+    class EnginePool {
+    public:
+        using Key = std::tuple<int, int, int, int, int>;
+
+        // Puts the engine back into the pool it came from instead of deleting it
+        struct Release {
+            EnginePool *pool = nullptr;
+            Key key{};
+
+            void operator()(IEngine *engine) const {
+                if (pool) {
+                    pool->release(key, engine);
+                } else {
+                    delete engine;
+                }
+            }
+        };
+
+        using Handle = std::unique_ptr<IEngine, Release>;
+
+        EnginePool() = default;
+        EnginePool(const EnginePool&) = delete;
+        EnginePool& operator=(const EnginePool&) = delete;
+
+        // An idle engine of this key after reset(), or a new one
+        Handle acquire(int pType, int vType, int vfType, int n, int m) {
+            Key key{pType, vType, vfType, n, m};
+            std::unique_ptr<IEngine> engine;
+            {
+                std::lock_guard lock(mutex_);
+                auto it = idle_.find(key);
+                if (it != idle_.end() && !it->second.empty()) {
+                    engine = std::move(it->second.back());
+                    it->second.pop_back();
+                    ++reused_;
+                } else {
+                    ++created_;
+                }
+            }
+            if (engine) {
+                engine->reset();
+            } else {
+                engine = FindEngineGenerator(pType, vType, vfType, n, m)();
+            }
+            return Handle(engine.release(), Release{this, key});
+        }
+
+        // Pooled counterpart of LoadEngine
+        Handle load(const std::string &path, int pType, int vType, int vfType) {
+            return LoadEngineWith(path, [&](int n, int m) {
+                return acquire(pType, vType, vfType, n, m);
+            });
+        }
+
+        // Deletes every idle engine
+        void trim() {
+            std::lock_guard lock(mutex_);
+            idle_.clear();
+        }
+
+        size_t created() const {
+            std::lock_guard lock(mutex_);
+            return created_;
+        }
+
+        size_t reused() const {
+            std::lock_guard lock(mutex_);
+            return reused_;
+        }
+
+    private:
+        void release(const Key &key, IEngine *engine) {
+            std::unique_ptr<IEngine> owned(engine);
+            std::lock_guard lock(mutex_);
+            idle_[key].push_back(std::move(owned));
+        }
+
+        mutable std::mutex mutex_;
+        std::map<Key, std::vector<std::unique_ptr<IEngine>>> idle_;
+        size_t created_ = 0;
+        size_t reused_ = 0;
+    };
+
+}
+
+#endif //FLUIDFINALVER_ENGINEPOOL_H
@@ -0,0 +1,8 @@
+// Compiled once per unit with ENGINE_UNIT=0..ENGINE_UNITS-1, see CMakeLists.txt
+#include "engineUnit.hpp"
+
+#if !defined(ENGINE_UNITS) || !defined(ENGINE_UNIT)
+#error "engineUnit.cpp needs ENGINE_UNITS and ENGINE_UNIT"
+#endif
+
+template struct FluidPhysics::EngineUnit<ENGINE_UNIT>;
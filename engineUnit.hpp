@@ -0,0 +1,38 @@
+#ifndef FLUIDFINALVER_ENGINEUNIT_H
+#define FLUIDFINALVER_ENGINEUNIT_H
+
+#include "generatorFactory.hpp"
+
+namespace FluidPhysics {
+
+    template<size_t idx>
+    std::unique_ptr<IEngine> makeEngine() {
+        return std::make_unique<FluidEngine<getType<std::get<0>(allCombos[idx])>,
+                getType<std::get<1>(allCombos[idx])>,
+                getType<std::get<2>(allCombos[idx])>,
+                std::get<3>(allCombos[idx]),
+                std::get<4>(allCombos[idx])>>();
+    }
+
+    // Only the combos a unit owns are instantiated in it
+    template<int Unit, size_t idx>
+    constexpr EngineFactory ownedFactory() {
+        if constexpr (idx % engineUnits == Unit) {
+            return &makeEngine<idx>;
+        } else {
+            return nullptr;
+        }
+    }
+
+    template<int Unit, size_t... idx>
+    constexpr std::array<EngineFactory, sizeof...(idx)> ownedFactories(std::index_sequence<idx...>) {
+        return {ownedFactory<Unit, idx>()...};
+    }
+
+    template<int Unit>
+    const std::array<EngineFactory, allCombos.size()> EngineUnit<Unit>::factories =
+            ownedFactories<Unit>(std::make_index_sequence<allCombos.size()>());
+
+}
+
+#endif //FLUIDFINALVER_ENGINEUNIT_H
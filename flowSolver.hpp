@@ -0,0 +1,149 @@
+#ifndef FLUIDFINALVER_FLOWSOLVER_H
+#define FLUIDFINALVER_FLOWSOLVER_H
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+
+#include "arraysTemps.hpp"
+
+namespace FluidPhysics {
+
+    enum class FlowSolverKind {
+        Dfs,      // reference: repeated full-grid scans, one unit-capped cycle per DFS
+        Blocking, // one blocking-flow phase with current-arc pointers and dead-end pruning
+    };
+
+    // Work done by one flow computation
+    struct FlowStats {
+        uint64_t iterations = 0;      // full passes over the open cells
+        uint64_t augmentingPaths = 0; // cycles along which flow was pushed
+        uint64_t maxDepth = 0;        // deepest search stack
+    };
+
+    // Finds a maximal circulation in the grid graph whose face capacities are the positive
+    // velocities. Like Dinic's blocking flow, every cell keeps a current-arc pointer and a cell
+    // whose arcs are exhausted is marked dead for the rest of the phase. Each cycle found
+    // saturates at least one face, so a phase costs O(V * E) and no second phase is needed:
+    // capacities only shrink, so a dead cell can never reach a cycle again.
+    template<typename FlowT>
+    class BlockingFlowSolver {
+    public:
+        void init(int n, int m) {
+            gridWidth = n;
+            gridHeight = m;
+            size_t cells = size_t(n) * m;
+            curArc.assign(cells, 0);
+            mark.assign(cells, 0);
+            stackPos.assign(cells, 0);
+            stack.clear();
+            stack.reserve(cells);
+            phase = 0;
+        }
+
+        // open[x][y] has bit d set for every non-wall neighbour, cells lists the non-wall cells
+        template<typename OpenMask, typename CapField, typename FlowField>
+        FlowStats solve(OpenMask &open, const std::vector<std::pair<int, int>> &cells, CapField &cap, FlowField &flow) {
+            FlowStats stats;
+            stats.iterations = 1;
+            // mark[c] == 2 * phase + 1 means on the stack, 2 * phase + 2 means dead
+            ++phase;
+            const uint32_t onStack = 2 * phase + 1;
+            const uint32_t dead = 2 * phase + 2;
+            std::fill(curArc.begin(), curArc.end(), 0);
+
+            auto residual = [&](int x, int y, size_t d) {
+                return FlowT(cap.get(x, y, d)) - flow.get(x, y, d);
+            };
+
+            for (auto [sx, sy] : cells) {
+                if (mark[index(sx, sy)] == dead) {
+                    continue;
+                }
+                push(sx, sy, onStack);
+                stats.maxDepth = std::max<uint64_t>(stats.maxDepth, stack.size());
+                while (!stack.empty()) {
+                    auto [x, y] = stack.back();
+                    size_t c = index(x, y);
+                    const unsigned arcs = open[x][y];
+                    bool advanced = false;
+                    for (; curArc[c] < deltas.size(); ++curArc[c]) {
+                        if (!(arcs & dirBit(curArc[c]))) continue;
+                        auto [dx, dy] = deltas[curArc[c]];
+                        int nx = x + dx, ny = y + dy;
+
+                        size_t nc = index(nx, ny);
+                        if (mark[nc] == dead || residual(x, y, curArc[c]) <= 0.0001) {
+                            continue;
+                        }
+                        if (mark[nc] == onStack) {
+                            cancel_cycle(stackPos[nc], residual, flow);
+                            ++stats.augmentingPaths;
+                        } else {
+                            push(nx, ny, onStack);
+                            stats.maxDepth = std::max<uint64_t>(stats.maxDepth, stack.size());
+                        }
+                        advanced = true;
+                        break;
+                    }
+                    if (!advanced) {
+                        mark[c] = dead;
+                        stack.pop_back();
+                    }
+                }
+            }
+            return stats;
+        }
+
+        size_t heapBytes() const {
+            return curArc.capacity() * sizeof(uint8_t) + mark.capacity() * sizeof(uint32_t) +
+                   stackPos.capacity() * sizeof(size_t) + stack.capacity() * sizeof(std::pair<int, int>);
+        }
+
+    private:
+        size_t index(int x, int y) const {
+            return size_t(x) * gridHeight + y;
+        }
+
+        void push(int x, int y, uint32_t onStack) {
+            size_t c = index(x, y);
+            mark[c] = onStack;
+            stackPos[c] = stack.size();
+            stack.emplace_back(x, y);
+        }
+
+        // Pushes the bottleneck around the cycle stack[from..top] -> stack[from], then retreats to stack[from]
+        template<typename Residual, typename FlowField>
+        void cancel_cycle(size_t from, Residual &residual, FlowField &flow) {
+            FlowT bottleneck{};
+            for (size_t i = from; i < stack.size(); ++i) {
+                auto [x, y] = stack[i];
+                FlowT r = residual(x, y, curArc[index(x, y)]);
+                if (i == from || r < bottleneck) {
+                    bottleneck = r;
+                }
+            }
+            for (size_t i = from; i < stack.size(); ++i) {
+                auto [x, y] = stack[i];
+                flow.add(x, y, size_t(curArc[index(x, y)]), bottleneck);
+            }
+            for (size_t i = from + 1; i < stack.size(); ++i) {
+                auto [x, y] = stack[i];
+                mark[index(x, y)] = 0;
+            }
+            stack.resize(from + 1);
+        }
+
+        int gridWidth = 0;
+        int gridHeight = 0;
+        uint32_t phase = 0;
+        std::vector<uint8_t> curArc;
+        std::vector<uint32_t> mark;
+        std::vector<size_t> stackPos;
+        std::vector<std::pair<int, int>> stack;
+    };
+
+}
+
+#endif //FLUIDFINALVER_FLOWSOLVER_H
@@ -0,0 +1,96 @@
+#ifndef FLUIDFINALVER_FRAMEOUTPUT_H
+#define FLUIDFINALVER_FRAMEOUTPUT_H
+
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace FluidPhysics {
+
+    enum class FrameMode {
+        Full,     // the whole grid after every step that moved something
+        Delta,    // "@<frame> <count>" followed by "<x> <y> <char>" for cells changed since the last frame
+        EveryNth, // full grid for every N-th frame only
+        None,
+    };
+
+    // Renders frames into one reusable buffer so each frame costs a single write to the stream
+    class FrameWriter {
+    public:
+        FrameWriter() = default;
+
+        FrameWriter(FrameMode mode, int every) : mode_(mode), every_(every) {
+            if (every_ <= 0) {
+                throw std::invalid_argument("Frame interval must be positive");
+            }
+        }
+
+        void write(std::ostream &out, const char *grid, int width, int height, int stride) {
+            long long frame = frame_++;
+            if (mode_ == FrameMode::None || (mode_ == FrameMode::EveryNth && frame % every_ != 0)) {
+                return;
+            }
+            buffer_.clear();
+            if (mode_ == FrameMode::Delta && previous_.size() == size_t(width) * height) {
+                appendDelta(frame, grid, width, height, stride);
+            } else {
+                appendFull(grid, width, height, stride);
+            }
+            if (mode_ == FrameMode::Delta) {
+                previous_.resize(size_t(width) * height);
+                for (int i = 0; i < width; ++i) {
+                    std::memcpy(previous_.data() + size_t(i) * height, grid + size_t(i) * stride, height);
+                }
+            }
+            out.write(buffer_.data(), std::streamsize(buffer_.size()));
+            out.flush();
+        }
+
+    private:
+        void appendFull(const char *grid, int width, int height, int stride) {
+            buffer_.reserve(size_t(width) * (height + 1));
+            for (int i = 0; i < width; ++i) {
+                buffer_.append(grid + size_t(i) * stride, height);
+                buffer_.push_back('\n');
+            }
+        }
+
+        void appendDelta(long long frame, const char *grid, int width, int height, int stride) {
+            size_t count = 0;
+            for (int i = 0; i < width; ++i) {
+                const char *row = grid + size_t(i) * stride;
+                const char *prev = previous_.data() + size_t(i) * height;
+                for (int j = 0; j < height; ++j) {
+                    if (row[j] != prev[j]) {
+                        changes_ += std::to_string(i);
+                        changes_ += ' ';
+                        changes_ += std::to_string(j);
+                        changes_ += ' ';
+                        changes_ += row[j];
+                        changes_ += '\n';
+                        ++count;
+                    }
+                }
+            }
+            buffer_ += '@';
+            buffer_ += std::to_string(frame);
+            buffer_ += ' ';
+            buffer_ += std::to_string(count);
+            buffer_ += '\n';
+            buffer_ += changes_;
+            changes_.clear();
+        }
+
+        FrameMode mode_ = FrameMode::Full;
+        int every_ = 1;
+        long long frame_ = 0;
+        std::string buffer_;
+        std::string changes_;
+        std::vector<char> previous_;
+    };
+
+}
+
+#endif //FLUIDFINALVER_FRAMEOUTPUT_H
@@ -1,6 +1,9 @@
 #ifndef FLUIDFINALVER_GENERATORFACTORY_H
 #define FLUIDFINALVER_GENERATORFACTORY_H
 
+#include <algorithm>
+#include <utility>
+
 #include "typeHolder.hpp"
 
 namespace FluidPhysics {
@@ -28,51 +31,119 @@ namespace FluidPhysics {
     }
 
     constexpr auto allCombos = GenerateAllCombo();
-    std::array<std::shared_ptr<FluidPhysics::IEngine>(*)(), allCombos.size()> generateEngine;
 
+    using EngineFactory = std::unique_ptr<IEngine>(*)();
 
-    template<int idx>
-    struct EngineGeneratorIdx {
-        EngineGeneratorIdx<idx - 1> x;
+#ifdef ENGINE_UNITS
+    // The engines are instantiated in ENGINE_UNITS separate translation units built from
+    // engineUnit.cpp, so this header only declares them and its includers compile quickly
+    constexpr int engineUnits = ENGINE_UNITS;
+#else
+    constexpr int engineUnits = 1;
+#endif
 
-        EngineGeneratorIdx() {
-            generateEngine[idx - 1] = generate;
-        }
+    // Factories of the combos unit Unit instantiates, the indices idx with idx % engineUnits == Unit,
+    // and nullptr for the others. Defined in engineUnit.hpp; the table is constant-initialised.
+    template<int Unit>
+    struct EngineUnit {
+        static const std::array<EngineFactory, allCombos.size()> factories;
+    };
 
-        static std::shared_ptr<FluidPhysics::IEngine> generate() {
-            return std::make_shared<FluidPhysics::FluidEngine<getType<std::get<0>(allCombos[idx - 1])>,
-                    getType<std::get<1>(allCombos[idx - 1])>,
-                    getType<std::get<2>(allCombos[idx - 1])>,
-                    std::get<3>(allCombos[idx - 1]),
-                    std::get<4>(allCombos[idx - 1])>>();
+    template<size_t... Unit>
+    constexpr auto engineUnitTables(std::index_sequence<Unit...>) {
+        return std::array<const std::array<EngineFactory, allCombos.size()> *, sizeof...(Unit)>{
+                &EngineUnit<int(Unit)>::factories...};
+    }
+
+    // Indices of allCombos in key order, so that lookups are a binary search over a table
+    // the compiler builds; nothing about the lookup runs before main()
+    constexpr auto comboOrder = [] {
+        std::array<size_t, allCombos.size()> order{};
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
         }
-    };
+        std::sort(order.begin(), order.end(), [](size_t a, size_t b) {
+            return allCombos[a] < allCombos[b];
+        });
+        return order;
+    }();
 
-    template<>
-    struct EngineGeneratorIdx<0> {
-        EngineGeneratorIdx() = default;
-    };
+    constexpr size_t noCombo = allCombos.size();
+
+    // Index into allCombos of exactly this key, or noCombo
+    constexpr size_t findCombo(const std::tuple<int, int, int, int, int> &key) {
+        auto it = std::lower_bound(comboOrder.begin(), comboOrder.end(), key, [](size_t idx, const auto &k) {
+            return allCombos[idx] < k;
+        });
+        return it != comboOrder.end() && allCombos[*it] == key ? *it : noCombo;
+    }
 
-    EngineGeneratorIdx<allCombos.size()> generator{};
+    static_assert(findCombo(allCombos[allCombos.size() - 1]) != noCombo &&
+                  findCombo(std::tuple(0, 0, 0, 0, 0)) == noCombo);
+
+    // Factory of allCombos[idx]
+    inline EngineFactory engineFactory(size_t idx) {
+        static constexpr auto tables = engineUnitTables(std::make_index_sequence<engineUnits>());
+        return (*tables[idx % engineUnits])[idx];
+    }
 }
 
-std::shared_ptr<FluidPhysics::IEngine> ProduceEngine(int pType, int vType, int vfType, int n, int m) {
-    auto itr = std::find(FluidPhysics::allCombos.begin(),
-                         FluidPhysics::allCombos.end(),
-                         std::tuple(pType, vType, vfType, n, m));
-    std::shared_ptr<FluidPhysics::IEngine> engine;
-    if (itr != FluidPhysics::allCombos.end()) {
-        engine = FluidPhysics::generateEngine[itr - FluidPhysics::allCombos.begin()]();
-    } else {
-        itr = std::find(FluidPhysics::allCombos.begin(),
-                        FluidPhysics::allCombos.end(),
-                        std::tuple(pType, vType, vfType, -1, -1));
-        if (itr == FluidPhysics::allCombos.end()) {
+// Generator of the engine for these types and size, falling back to the dynamic engine
+// when the size was not compiled in
+inline FluidPhysics::EngineFactory FindEngineGenerator(int pType, int vType, int vfType, int n, int m) {
+    size_t idx = FluidPhysics::findCombo({pType, vType, vfType, n, m});
+    if (idx == FluidPhysics::noCombo) {
+        idx = FluidPhysics::findCombo({pType, vType, vfType, -1, -1});
+        if (idx == FluidPhysics::noCombo) {
             throw std::invalid_argument("unknown types");
         }
-        engine = FluidPhysics::generateEngine[itr - FluidPhysics::allCombos.begin()]();
     }
+    return FluidPhysics::engineFactory(idx);
+}
+
+// One line per compiled-in engine, in lookup order
+inline void ListEngines(std::ostream &out) {
+    for (size_t idx : FluidPhysics::comboOrder) {
+        auto [pType, vType, vfType, n, m] = FluidPhysics::allCombos[idx];
+        out << GetTypeName(pType) << " " << GetTypeName(vType) << " " << GetTypeName(vfType) << " "
+            << (n == -1 ? std::string("dynamic") : std::to_string(n) + "x" + std::to_string(m)) << "\n";
+    }
+    out << FluidPhysics::allCombos.size() << " engines in " << FluidPhysics::engineUnits << " units" << std::endl;
+}
+
+inline std::shared_ptr<FluidPhysics::IEngine> ProduceEngine(int pType, int vType, int vfType, int n, int m) {
+    return FindEngineGenerator(pType, vType, vfType, n, m)();
+}
+
+// Maps a text or binary checkpoint once and loads it into the engine produce(n, m) returns
+// for the grid size stored in the file
+template<typename Produce>
+auto LoadEngineWith(const std::string &path, Produce &&produce) {
+    const FluidPhysics::MappedFile inputMap(path);
+    if (FluidPhysics::isBinaryCheckpoint(inputMap)) {
+        const auto header = FluidPhysics::readCheckpointHeader(inputMap);
+        auto engine = produce(header.width, header.height);
+        engine->loadBinary(inputMap);
+        return engine;
+    }
+
+    FluidPhysics::TextScanner header(inputMap);
+    const int n = header.number<int>();
+    const int m = header.number<int>();
+    auto engine = produce(n, m);
+    engine->load(inputMap);
     return engine;
 }
 
+// Creates the engine for the given types and loads a text or binary checkpoint into it
+inline std::shared_ptr<FluidPhysics::IEngine> LoadEngine(const std::string &path, int pType, int vType, int vfType) {
+    return LoadEngineWith(path, [&](int n, int m) {
+        return ProduceEngine(pType, vType, vfType, n, m);
+    });
+}
+
+#ifndef ENGINE_UNITS
+#include "engineUnit.hpp"
+#endif
+
 #endif //FLUIDFINALVER_GENERATORFACTORY_H
@@ -5,15 +5,21 @@
 #include <signal.h>
 #include <cstdio>
 #include <filesystem>
+#include <chrono>
+#include <thread>
+#include <algorithm>
 
 #include "generatorFactory.hpp"
+#include "snapshotWriter.hpp"
+#include "batchRunner.hpp"
+#include "autoTune.hpp"
 
 namespace fs = std::filesystem;
 
-bool isSave = false;
+volatile sig_atomic_t isSave = 0;
 
 void handle_sigquit(int signum) {
-    isSave = true;
+    isSave = 1;
 }
 
 void validateFile(const fs::path& filePath) {
@@ -24,7 +30,59 @@ void validateFile(const fs::path& filePath) {
 
 int main(int argc, char* argv[]) {
     OptionsParser optsParser(argc, argv);
-    int n = 0, m = 0;
+    if (optsParser.hasOpt("--list-engines")) {
+        ListEngines(std::cout);
+        return 0;
+    }
+    const int threads = optsParser.hasOpt("--threads") ? optsParser.getOptValAsInt("--threads") : 1;
+    const auto flowSolver = optsParser.hasOpt("--flow-solver")
+            ? GetFlowSolverKind(optsParser.getOptVal("--flow-solver"))
+            : FluidPhysics::FlowSolverKind::Dfs;
+    const auto kernelPath = optsParser.hasOpt("--kernels")
+            ? GetKernelPath(optsParser.getOptVal("--kernels"))
+            : FluidPhysics::KernelPath::Auto;
+    const auto rngKind = optsParser.hasOpt("--rng")
+            ? GetRngKind(optsParser.getOptVal("--rng"))
+            : FluidPhysics::RngKind::Mt19937;
+    const uint64_t seed = optsParser.hasOpt("--seed") ? optsParser.getOptValAsInt("--seed") : FluidPhysics::EngineRandom::defaultSeed;
+    const auto saveFormat = optsParser.hasOpt("--save-format")
+            ? GetCheckpointFormat(optsParser.getOptVal("--save-format"))
+            : FluidPhysics::CheckpointFormat::Binary;
+    const int snapshotEvery = optsParser.hasOpt("--snapshot-every") ? optsParser.getOptValAsInt("--snapshot-every") : 0;
+    const int snapshotKeep = optsParser.hasOpt("--snapshot-keep") ? optsParser.getOptValAsInt("--snapshot-keep") : 3;
+    const auto [frameMode, frameEvery] = optsParser.hasOpt("--frames")
+            ? GetFrameMode(optsParser.getOptVal("--frames"))
+            : std::pair(FluidPhysics::FrameMode::Full, 1);
+    const int steps = optsParser.hasOpt("--steps") ? optsParser.getOptValAsInt("--steps") : 10000;
+    const bool headless = optsParser.hasOpt("--headless");
+    const bool profile = optsParser.hasOpt("--profile");
+    const std::string statsFileName = optsParser.hasOpt("--stats") ? optsParser.getOptVal("--stats") : "";
+    const bool parallelMove = optsParser.hasOpt("--parallel-move");
+    const double activeEpsilon = optsParser.hasOpt("--active-eps") ? optsParser.getOptValAsDouble("--active-eps") : 0.0;
+    const std::string recordFileName = optsParser.hasOpt("--record") ? optsParser.getOptVal("--record") : "";
+    const uint32_t recordFields = optsParser.hasOpt("--record-fields")
+            ? GetRecordFields(optsParser.getOptVal("--record-fields"))
+            : FluidPhysics::RecordGrid;
+    const int autoTuneSteps = optsParser.hasOpt("--auto-tune") ? optsParser.getOptValAsInt("--auto-tune") : 0;
+    const double autoTuneTolerance = optsParser.hasOpt("--auto-tol") ? optsParser.getOptValAsDouble("--auto-tol") : 0.05;
+    const int recordKeyframe = optsParser.hasOpt("--record-keyframe") ? optsParser.getOptValAsInt("--record-keyframe") : 64;
+
+    if (optsParser.hasOpt("--batch")) {
+        // Jobs run side by side on single-threaded engines, one per core unless --threads says otherwise
+        const auto jobs = FluidPhysics::readBatchManifest(optsParser.getOptVal("--batch"));
+        FluidPhysics::BatchSettings settings;
+        settings.threads = optsParser.hasOpt("--threads")
+                ? threads
+                : int(std::clamp<size_t>(std::thread::hardware_concurrency(), 1, std::max<size_t>(jobs.size(), 1)));
+        settings.flowSolver = flowSolver;
+        settings.kernelPath = kernelPath;
+        settings.rngKind = rngKind;
+        settings.seed = seed;
+        settings.saveFormat = saveFormat;
+        settings.activeEpsilon = activeEpsilon;
+        return FluidPhysics::runBatch(jobs, settings, std::cerr) == 0 ? 0 : 1;
+    }
+
     std::string inputFile;
     try {
         inputFile = optsParser.getOptVal("--input");
@@ -32,46 +90,104 @@ int main(int argc, char* argv[]) {
         throw std::invalid_argument("Missing required --input argument: " + std::string(ex.what()));
     }
     const auto saveFileName = optsParser.getOptVal("--output");
-    const int pTypeCode = GetTypeCode(optsParser.getOptVal("--p-type"));
-    const int vTypeCode = GetTypeCode(optsParser.getOptVal("--v-type"));
-    const int vFlowTypeCode = GetTypeCode(optsParser.getOptVal("--v-flow-type"));
-
 
     const fs::path inputFilePath = inputFile;
     validateFile(inputFilePath);
 
-    std::ifstream input(inputFilePath);
-    if (!input.is_open()) {
-        throw std::runtime_error("Failed to open input file: " + inputFilePath.string());
-    }
+    signal(SIGQUIT, handle_sigquit);
 
-    if (!(input >> n >> m)) {
-        throw std::runtime_error("Failed to read 'n' and 'm' from input file: " + inputFilePath.string());
+    auto configure = [&](FluidPhysics::IEngine& engine) {
+        engine.setThreadCount(threads);
+        engine.setFlowSolver(flowSolver);
+        engine.setKernelPath(kernelPath);
+        engine.setRandom(rngKind, seed);
+        engine.setParallelMovement(parallelMove);
+        engine.setActiveEpsilon(activeEpsilon);
+        engine.setFrameMode(frameMode, frameEvery);
+        engine.enableProfiling(profile);
+    };
+
+    std::shared_ptr<FluidPhysics::IEngine> engine;
+    // With --auto-tune the run goes on with the chosen engine after its calibration steps
+    int firstStep = 0;
+    if (autoTuneSteps > 0) {
+        FluidPhysics::AutoTuneSettings tuneSettings;
+        tuneSettings.steps = std::min(autoTuneSteps, steps);
+        tuneSettings.tolerance = autoTuneTolerance;
+        auto tuned = FluidPhysics::autoTune(inputFilePath.string(), tuneSettings, configure, std::cerr);
+        engine = std::move(tuned.engine);
+        firstStep = tuned.steps;
+    } else {
+        const int pTypeCode = GetTypeCode(optsParser.getOptVal("--p-type"));
+        const int vTypeCode = GetTypeCode(optsParser.getOptVal("--v-type"));
+        const int vFlowTypeCode = GetTypeCode(optsParser.getOptVal("--v-flow-type"));
+
+        const auto loadStart = std::chrono::steady_clock::now();
+        engine = LoadEngine(inputFilePath.string(), pTypeCode, vTypeCode, vFlowTypeCode);
+        const std::chrono::duration<double> loadTime = std::chrono::steady_clock::now() - loadStart;
+        if (headless || profile) {
+            const double megabytes = double(fs::file_size(inputFilePath)) / 1e6;
+            std::cerr << "loaded " << megabytes << " MB in " << loadTime.count() << " s ("
+                      << (loadTime.count() > 0 ? megabytes / loadTime.count() : 0.0) << " MB/s)" << std::endl;
+        }
+        configure(*engine);
     }
 
-    input.clear();
-    input.seekg(0, std::ios::beg);
-
-    signal(SIGQUIT, handle_sigquit);
+    FluidPhysics::SnapshotWriter snapshots(saveFileName, saveFormat, snapshotKeep);
 
-    auto engine = ProduceEngine(pTypeCode, vTypeCode, vFlowTypeCode, n, m);
-
-    std::ofstream saveFile(saveFileName);
-    if (!saveFile.is_open()) {
-        throw std::invalid_argument("Can't open save file: " + saveFileName);
+    std::ofstream statsFile;
+    if (!statsFileName.empty()) {
+        statsFile.open(statsFileName, std::ios::trunc);
+        if (!statsFile.is_open()) {
+            throw std::runtime_error("Failed to open stats file: " + statsFileName);
+        }
+        FluidPhysics::writeStepStatsHeader(statsFile);
     }
 
-    engine->load(input);
+    // Every step's state goes to the recording, frame i being the state after step i
+    std::optional<FluidPhysics::FrameRecorder> recorder;
+    std::vector<char> frame;
+    if (!recordFileName.empty()) {
+        recorder.emplace(recordFileName, engine->frameLayout(), recordFields, uint32_t(recordKeyframe));
+    }
 
-    const int T = 10000;
-    for (int i = 0; i < T; ++i) {
-        if (isSave) {
-            std::cout << "\nSaving\n";
-            engine->save(saveFile);
-            isSave = false;
-            std::cout << "Saved in file " << saveFileName << std::endl;
+    const auto startTime = std::chrono::steady_clock::now();
+    for (int i = firstStep; i < steps; ++i) {
+        if (isSave || (snapshotEvery > 0 && i > 0 && i % snapshotEvery == 0)) {
+            snapshots.capture(*engine);
+            isSave = 0;
+        }
+        if (headless) {
+            engine->next(std::nullopt);
+        } else {
+            engine->next(std::cout);
+        }
+        if (statsFile.is_open()) {
+            FluidPhysics::writeStepStats(statsFile, i, engine->lastStepStats());
         }
-        engine->next(std::cout);
+        if (recorder) {
+            engine->captureFrame(recorder->fields(), frame);
+            recorder->append(frame);
+        }
+    }
+    if (recorder) {
+        recorder->close();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+    if (headless || profile) {
+        std::cerr << steps - firstStep << " steps in " << elapsed.count() << " s ("
+                  << (elapsed.count() > 0 ? (steps - firstStep) / elapsed.count() : 0.0) << " steps/s)" << std::endl;
+    }
+    if (recorder && (headless || profile)) {
+        std::cerr << "recorded " << recorder->frameCount() << " frames: " << recorder->rawBytes() / 1024 << " KiB raw, "
+                  << recorder->encodedBytes() / 1024 << " KiB encoded" << std::endl;
+    }
+    if (activeEpsilon > 0) {
+        std::cerr << "active fraction: " << engine->activeFraction() * 100 << "% of tiles per step" << std::endl;
+    }
+    if (profile) {
+        engine->reportProfile(std::cerr);
     }
 
     return 0;
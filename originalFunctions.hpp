@@ -8,14 +8,25 @@
 #include <limits>
 #include <tuple>
 #include <algorithm>
+#include <bit>
 #include <sstream>
 #include <optional>
 #include <fstream>
+#include <memory>
+#include <span>
 
 #include "Fixed.hpp"
 #include "specialArr.hpp"
 #include "arraysTemps.hpp"
 #include "random.hpp"
+#include "threadPool.hpp"
+#include "flowSolver.hpp"
+#include "checkpoint.hpp"
+#include "frameOutput.hpp"
+#include "profiler.hpp"
+#include "simdKernels.hpp"
+#include "activeRegion.hpp"
+#include "recording.hpp"
 
 using namespace std;
 
@@ -24,8 +35,38 @@ namespace FluidPhysics {
     class IEngine {
     public:
         virtual void next(std::optional<std::reference_wrapper<std::ostream>> out) = 0;
-        virtual void load(std::ifstream& file) = 0;
-        virtual void save(std::ofstream& file) = 0;
+        // Text checkpoint as written by save()
+        virtual void load(const MappedFile& file) = 0;
+        virtual void save(std::ostream& file) = 0;
+        virtual void loadBinary(const MappedFile& file) = 0;
+        virtual void saveBinary(std::ostream& file) = 0;
+        // Copies the saved state (grid, lastUsage, pressure, velocity) into staging,
+        // replacing it with a new engine of the same type if it holds anything else
+        virtual void copyStateTo(std::unique_ptr<IEngine>& staging) const = 0;
+        virtual void setThreadCount(int threads) = 0;
+        virtual void setFlowSolver(FlowSolverKind kind) = 0;
+        virtual void setFrameMode(FrameMode mode, int every) = 0;
+        virtual void setKernelPath(KernelPath path) = 0;
+        virtual void setRandom(RngKind kind, uint64_t seed) = 0;
+        // Tile-scheduled movement phase; needs RngKind::Philox and changes the visiting order
+        virtual void setParallelMovement(bool on) = 0;
+        // Skip tiles whose cells changed by less than epsilon in the last step; 0 processes every cell
+        virtual void setActiveEpsilon(double epsilon) = 0;
+        // Share of tiles processed per step while tracking is on, 1 otherwise
+        virtual double activeFraction() const = 0;
+        virtual void enableProfiling(bool on) = 0;
+        virtual void reportProfile(std::ostream& out) const = 0;
+        // Counters and phase timings of the last next() call
+        virtual const StepStats& lastStepStats() const = 0;
+        // Returns the engine to its just-constructed settings and state but keeps the grids it
+        // allocated, so that a pooled engine can load the next scene without touching new pages
+        virtual void reset() = 0;
+        virtual std::pair<int, int> gridSize() const = 0;
+        // Bytes held by the engine object and the grids and buffers it allocated
+        virtual size_t memoryUsage() const = 0;
+        virtual FrameLayout frameLayout() const = 0;
+        // Current state of the RecordField fields in fields, laid out as FrameLayout::frameBytes describes
+        virtual void captureFrame(uint32_t fields, std::vector<char>& raw) const = 0;
         virtual ~IEngine() = default;
 
 //        virtual void writeToStream(std::ostream& out) = 0;
@@ -35,7 +76,8 @@ namespace FluidPhysics {
     };
 
 
-    template <typename PressureType, typename VelocityType, typename FlowVelocityType, int Width, int Height>
+    template <typename PressureType, typename VelocityType, typename FlowVelocityType, int Width, int Height,
+            FieldLayout VelocityLayout = FieldLayout::AoS>
     class FluidEngine : public IEngine {
     private:
         int gridWidth = Width;
@@ -44,84 +86,209 @@ namespace FluidPhysics {
         // implement static assert for the types
 
         Array<char, Width, Height> simulationGrid{};
-        VectorField<VelocityType, Width, Height> velocityField{};
-        VectorField<FlowVelocityType, Width, Height> flowVelocityField{};
+        VectorField<VelocityType, Width, Height, VelocityLayout> velocityField{};
+        VectorField<FlowVelocityType, Width, Height, VelocityLayout> flowVelocityField{};
         Array<PressureType, Width, Height> pressure{};
         Array<PressureType, Width, Height> previousPressure{};
-        Array<int64_t, Height, Height> directionMatrix{};
-        Array<int, Height, Height> lastUsage{};
+        Array<int64_t, Width, Height> directionMatrix{};
+        // Bit d is set when the neighbour in direction d is inside the grid and not a wall.
+        // Walls never move, so init() builds it once together with the open cell list.
+        // With active-region tracking both only cover the tiles active in the current step.
+        Array<uint8_t, Width, Height> openNeighbours{};
+        // Non-wall cells in row-major order, the order every full-grid pass visits them in
+        std::vector<std::pair<int, int>> openCells;
+        // The single span [0, gridHeight) every row has while tracking is off
+        std::vector<std::pair<int, int>> fullRow;
+
+        ActiveRegion activity;
+        PressureType pressureEpsilon{};
+        VelocityType velocityEpsilon{};
+        // Velocities of openCells at the start of the step, in the same order
+        std::vector<std::array<VelocityType, deltas.size()>> velocitySnapshot;
+        Array<int, Width, Height> lastUsage{};
         int updateTimestamp = 0;
         PressureType densityLevels[256];
+        // Reciprocals of densityLevels and directionMatrix, rebuilt by init(), so the stencil passes only multiply
+        Reciprocal<PressureType> densityReciprocal[256];
+        Array<Reciprocal<PressureType>, Width, Height> directionReciprocal{};
+        // Per-cell direction masks of the pressure-force pass, see pressureMaskRow
+        Array<uint8_t, Width, Height> pressureMask{};
+
+
+        struct FlowFrame {
+            int x, y;
+            FlowVelocityType lim;
+            FlowVelocityType ret;
+            size_t dir;
+        };
+
+        struct StopFrame {
+            int x, y;
+            size_t dir;
+        };
+
+        struct MoveFrame {
+            int x, y;
+            int nx, ny;
+            bool isFirst;
+        };
+
+        // Stacks of the stop and move traversals and the box [x0, x1) x [y0, y1) they may touch.
+        // The serial movement phase has one scope over the whole grid; parallel movement gives
+        // every worker its own scope, confined to the region of the tile it owns.
+        struct MoveScope {
+            std::vector<StopFrame> stopStack;
+            std::vector<MoveFrame> moveStack;
+            int x0 = 0, x1 = 0, y0 = 0, y1 = 0;
+            // Swaps made and deepest moveStack since the scope was last cleared for a step
+            uint64_t swaps = 0;
+            uint64_t maxDepth = 0;
+
+            // Direction bits of the neighbours of (x, y) that lie inside the box
+            unsigned inside(int x, int y) const {
+                return (x > x0 ? dirBit(Up) : 0u) | (x + 1 < x1 ? dirBit(Down) : 0u) |
+                       (y > y0 ? dirBit(Left) : 0u) | (y + 1 < y1 ? dirBit(Right) : 0u);
+            }
+        };
+
+        // Explicit DFS stacks, reserved for the whole grid in init() so that a step never reallocates
+        std::vector<FlowFrame> flowStack;
+        uint64_t flowDepth = 0;
+        MoveScope serialMove;
+        std::vector<MoveScope> parallelMove;
+        bool parallelMovement = false;
+        std::vector<std::pair<int, int>> moveTiles;
+        std::vector<char> movedInChunk;
 
+        std::unique_ptr<ThreadPool> pool;
+        std::vector<PressureType> bandDeltas;
+
+        // Edge of the tiles parallel movement hands out to workers
+        static constexpr int moveTile = 16;
+
+        FrameWriter frameWriter;
+        StepProfiler profiler;
+        StepStats stats;
+
+        FlowSolverKind flowSolver = FlowSolverKind::Dfs;
+        KernelPath kernelPath = resolveKernelPath(KernelPath::Auto);
+        EngineRandom random;
+        BlockingFlowSolver<FlowVelocityType> blockingSolver;
 
         std::tuple<FlowVelocityType, bool, pair<int, int>> propagate_flow(int x, int y, FlowVelocityType lim) {
+            std::tuple<FlowVelocityType, bool, pair<int, int>> res{};
+            bool returning = false;
+            flowStack.clear();
             lastUsage[x][y] = updateTimestamp - 1;
-            FlowVelocityType ret{};
-            for (auto [dx, dy] : deltas) {
-                int nx = x + dx, ny = y + dy;
-                if (nx < 0 || nx >= gridWidth || ny < 0 || ny >= gridHeight) continue;
-
-                if (simulationGrid[nx][ny] != '#' && lastUsage[nx][ny] < updateTimestamp) {
-                    VelocityType cap = velocityField.get(x, y, dx, dy);
-                    FlowVelocityType flow = flowVelocityField.get(x, y, dx, dy);
-                    if (fabs(flow - FlowVelocityType(cap)) <= 0.0001) {
+            flowStack.push_back({x, y, lim, {}, 0});
+            while (!flowStack.empty()) {
+                FlowFrame &fr = flowStack.back();
+                if (returning) {
+                    returning = false;
+                    auto [t, prop, end] = res;
+                    fr.ret += t;
+                    if (prop) {
+                        flowVelocityField.add(fr.x, fr.y, fr.dir, t);
+                        lastUsage[fr.x][fr.y] = updateTimestamp;
+                        res = {t, end != pair(fr.x, fr.y), end};
+                        flowStack.pop_back();
+                        returning = true;
                         continue;
                     }
-                    // assert(v >= flowVelocityField.get(x, y, dx, dy));
-                    FlowVelocityType vp = std::min(lim, FlowVelocityType(cap) - flow);
-                    if (lastUsage[nx][ny] == updateTimestamp - 1) {
-                        flowVelocityField.add(x, y, dx, dy, vp);
-                        lastUsage[x][y] = updateTimestamp;
-                        // cerr << x << " " << y << " -> " << nx << " " << ny << " " << vp << " / " << lim << "\n";
-                        return {vp, true, {nx, ny}};
-                    }
-                    auto [t, prop, end] = propagate_flow(nx, ny, vp);
-                    ret += t;
-                    if (prop) {
-                        flowVelocityField.add(x, y, dx, dy, t);
-                        lastUsage[x][y] = updateTimestamp;
-                        // cerr << x << " " << y << " -> " << nx << " " << ny << " " << t << " / " << lim << "\n";
-                        return {t, prop && end != pair(x, y), end};
+                    ++fr.dir;
+                }
+                bool descended = false;
+                const unsigned open = openNeighbours[fr.x][fr.y];
+                for (; fr.dir < deltas.size(); ++fr.dir) {
+                    if (!(open & dirBit(fr.dir))) continue;
+                    auto [dx, dy] = deltas[fr.dir];
+                    int nx = fr.x + dx, ny = fr.y + dy;
+
+                    if (lastUsage[nx][ny] < updateTimestamp) {
+                        VelocityType cap = velocityField.get(fr.x, fr.y, fr.dir);
+                        FlowVelocityType flow = flowVelocityField.get(fr.x, fr.y, fr.dir);
+                        if (fabs(flow - FlowVelocityType(cap)) <= 0.0001) {
+                            continue;
+                        }
+                        FlowVelocityType vp = std::min(fr.lim, FlowVelocityType(cap) - flow);
+                        if (lastUsage[nx][ny] == updateTimestamp - 1) {
+                            flowVelocityField.add(fr.x, fr.y, fr.dir, vp);
+                            lastUsage[fr.x][fr.y] = updateTimestamp;
+                            res = {vp, true, {nx, ny}};
+                            flowStack.pop_back();
+                            returning = true;
+                        } else {
+                            lastUsage[nx][ny] = updateTimestamp - 1;
+                            flowStack.push_back({nx, ny, vp, {}, 0});
+                            flowDepth = std::max<uint64_t>(flowDepth, flowStack.size());
+                        }
+                        descended = true;
+                        break;
                     }
                 }
+                if (!descended) {
+                    lastUsage[fr.x][fr.y] = updateTimestamp;
+                    res = {fr.ret, false, {0, 0}};
+                    flowStack.pop_back();
+                    returning = true;
+                }
             }
-            lastUsage[x][y] = updateTimestamp;
-            return {ret, false, {0, 0}};
+            return res;
         }
 
-        void propagate_stop(int x, int y, bool force = false) {
-            if (!force) {
-                for (auto [dx, dy] : deltas) {
-                    int nx = x + dx, ny = y + dy;
-                    if (nx < 0 || nx >= gridWidth || ny < 0 || ny >= gridHeight) continue;
+        bool stoppable(const MoveScope &scope, int x, int y) {
+            for (unsigned open = openNeighbours[x][y] & scope.inside(x, y); open != 0; open &= open - 1) {
+                size_t d = std::countr_zero(open);
+                auto [dx, dy] = deltas[d];
+                int nx = x + dx, ny = y + dy;
 
-                    if (simulationGrid[nx][ny] != '#' && lastUsage[nx][ny] < updateTimestamp - 1 && velocityField.get(x, y, dx, dy) > 0ll) {
-                        return;
-                    }
+                if (lastUsage[nx][ny] < updateTimestamp - 1 && velocityField.get(x, y, d) > 0ll) {
+                    return false;
                 }
             }
+            return true;
+        }
+
+        void propagate_stop(MoveScope &scope, int x, int y, bool force = false) {
+            if (!force && !stoppable(scope, x, y)) {
+                return;
+            }
+            auto &stopStack = scope.stopStack;
             lastUsage[x][y] = updateTimestamp;
-            for (auto [dx, dy] : deltas) {
-                int nx = x + dx, ny = y + dy;
-                if (nx < 0 || nx >= gridWidth || ny < 0 || ny >= gridHeight) continue;
+            stopStack.clear();
+            stopStack.push_back({x, y, 0});
+            while (!stopStack.empty()) {
+                StopFrame &fr = stopStack.back();
+                if (fr.dir == deltas.size()) {
+                    stopStack.pop_back();
+                    continue;
+                }
+                size_t d = fr.dir++;
+                if (!(openNeighbours[fr.x][fr.y] & scope.inside(fr.x, fr.y) & dirBit(d))) continue;
+                auto [dx, dy] = deltas[d];
+                int nx = fr.x + dx, ny = fr.y + dy;
 
-                if (simulationGrid[nx][ny] == '#' || lastUsage[nx][ny] == updateTimestamp || velocityField.get(x, y, dx, dy) > 0ll) {
+                if (lastUsage[nx][ny] == updateTimestamp || velocityField.get(fr.x, fr.y, d) > 0ll) {
                     continue;
                 }
-                propagate_stop(nx, ny);
+                if (stoppable(scope, nx, ny)) {
+                    lastUsage[nx][ny] = updateTimestamp;
+                    stopStack.push_back({nx, ny, 0});
+                }
             }
         }
 
-        VelocityType move_prob(int x, int y) {
+        VelocityType move_prob(const MoveScope &scope, int x, int y) {
             VelocityType sum{};
-            for (auto [dx, dy] : deltas) {
+            for (unsigned open = openNeighbours[x][y] & scope.inside(x, y); open != 0; open &= open - 1) {
+                size_t d = std::countr_zero(open);
+                auto [dx, dy] = deltas[d];
                 int nx = x + dx, ny = y + dy;
-                if (nx < 0 || nx >= gridWidth || ny < 0 || ny >= gridHeight) continue;
 
-                if (simulationGrid[nx][ny] == '#' || lastUsage[nx][ny] == updateTimestamp) {
+                if (lastUsage[nx][ny] == updateTimestamp) {
                     continue;
                 }
-                VelocityType v = velocityField.get(x, y, dx, dy);
+                VelocityType v = velocityField.get(x, y, d);
                 if (v < 0ll) {
                     continue;
                 }
@@ -133,239 +300,650 @@ namespace FluidPhysics {
         void swap(int x1, int y1, int x2, int y2) {
             std::swap(simulationGrid[x1][y1], simulationGrid[x2][y2]);
             std::swap(pressure[x1][y1], pressure[x2][y2]);
-            std::swap(velocityField.v[x1][y1], velocityField.v[x2][y2]);
+            velocityField.swapCells(x1, y1, x2, y2);
+            if (activity.enabled()) {
+                activity.markCell(x1, y1);
+                activity.markCell(x2, y2);
+            }
         }
 
-        bool propagate_move(int x, int y, bool is_first) {
-            lastUsage[x][y] = updateTimestamp - is_first;
+        // Draws are keyed by updateTimestamp, which is fixed during the movement phase and kept in
+        // checkpoints, so a resumed Philox run repeats the draws of the original one
+        VelocityType random01(int x, int y, uint32_t stream) {
+            return random.template random01<VelocityType>(uint32_t(updateTimestamp), uint32_t(x * gridHeight + y), stream);
+        }
+
+        bool propagate_move(MoveScope &scope, int x, int y, bool is_first) {
+            auto &moveStack = scope.moveStack;
             bool ret = false;
-            int nx = -1, ny = -1;
-            do {
-                std::array<VelocityType, deltas.size()> tres;
-                VelocityType sum{};
-                for (size_t i = 0; i < deltas.size(); ++i) {
-                    auto [dx, dy] = deltas[i];
-                    int fx = x + dx, fy = y + dy;
-                    if (fx < 0 || fx >= gridWidth || fy < 0 || fy >= gridHeight) continue;
-
-                    if (simulationGrid[fx][fy] == '#' || lastUsage[fx][fy] == updateTimestamp) {
-                        tres[i] = sum;
-                        continue;
-                    }
-                    VelocityType v = velocityField.get(x, y, dx, dy);
-                    if (v < 0ll) {
+            bool returning = false;
+            moveStack.clear();
+            lastUsage[x][y] = updateTimestamp - is_first;
+            moveStack.push_back({x, y, -1, -1, is_first});
+            while (!moveStack.empty()) {
+                MoveFrame &fr = moveStack.back();
+                bool done = returning && ret;
+                returning = false;
+                if (!done) {
+                    std::array<VelocityType, deltas.size()> tres;
+                    VelocityType sum{};
+                    const unsigned open = openNeighbours[fr.x][fr.y] & scope.inside(fr.x, fr.y);
+                    for (size_t i = 0; i < deltas.size(); ++i) {
+                        auto [dx, dy] = deltas[i];
+                        int fx = fr.x + dx, fy = fr.y + dy;
+
+                        if (!(open & dirBit(i)) || lastUsage[fx][fy] == updateTimestamp) {
+                            tres[i] = sum;
+                            continue;
+                        }
+                        VelocityType v = velocityField.get(fr.x, fr.y, i);
+                        if (v < 0ll) {
+                            tres[i] = sum;
+                            continue;
+                        }
+                        sum += v;
                         tres[i] = sum;
-                        continue;
                     }
-                    sum += v;
-                    tres[i] = sum;
-                }
 
-                if (sum == 0ll) {
-                    break;
-                }
+                    if (sum == 0ll) {
+                        ret = false;
+                    } else {
+                        VelocityType randNum = random01(fr.x, fr.y, 1) * sum;
+                        size_t d = std::ranges::upper_bound(tres, randNum) - tres.begin();
 
-                VelocityType randNum = random01<VelocityType>() * sum;
-                size_t d = std::ranges::upper_bound(tres, randNum) - tres.begin();
+                        auto [dx, dy] = deltas[d];
+                        fr.nx = fr.x + dx;
+                        fr.ny = fr.y + dy;
+                        assert(velocityField.get(fr.x, fr.y, d) > 0ll && simulationGrid[fr.nx][fr.ny] != '#' && lastUsage[fr.nx][fr.ny] < updateTimestamp);
 
-                auto [dx, dy] = deltas[d];
-                nx = x + dx;
-                ny = y + dy;
-                assert(velocityField.get(x, y, dx, dy) > 0ll && simulationGrid[nx][ny] != '#' && lastUsage[nx][ny] < updateTimestamp);
+                        if (lastUsage[fr.nx][fr.ny] != updateTimestamp - 1) {
+                            lastUsage[fr.nx][fr.ny] = updateTimestamp;
+                            moveStack.push_back({fr.nx, fr.ny, -1, -1, false});
+                            scope.maxDepth = std::max<uint64_t>(scope.maxDepth, moveStack.size());
+                            continue;
+                        }
+                        ret = true;
+                    }
+                }
 
-                ret = (lastUsage[nx][ny] == updateTimestamp - 1 || propagate_move(nx, ny, false));
-            } while (!ret);
-            lastUsage[x][y] = updateTimestamp;
-            for (auto [dx, dy] : deltas) {
-                int fx = x + dx, fy = y + dy;
-                if (fx < 0 || fx >= gridWidth || fy < 0 || fy >= gridHeight) continue;
+                lastUsage[fr.x][fr.y] = updateTimestamp;
+                // nx stays -1 when the cell had nowhere to go, so there is no target to stop
+                for (unsigned open = fr.nx >= 0 ? openNeighbours[fr.x][fr.y] & scope.inside(fr.x, fr.y) : 0u; open != 0; open &= open - 1) {
+                    size_t d = std::countr_zero(open);
+                    auto [dx, dy] = deltas[d];
+                    int fx = fr.x + dx, fy = fr.y + dy;
 
-                if (simulationGrid[fx][fy] != '#' && lastUsage[fx][fy] < updateTimestamp - 1 && velocityField.get(x, y, dx, dy) < 0ll) {
-                    propagate_stop(nx, ny);
+                    if (lastUsage[fx][fy] < updateTimestamp - 1 && velocityField.get(fr.x, fr.y, d) < 0ll) {
+                        propagate_stop(scope, fr.nx, fr.ny);
+                    }
                 }
-            }
-            if (ret && !is_first) {
-                swap(x, y, nx, ny);
+                if (ret && !fr.isFirst) {
+                    swap(fr.x, fr.y, fr.nx, fr.ny);
+                    ++scope.swaps;
+                }
+                moveStack.pop_back();
+                returning = true;
             }
             return ret;
         }
 
         void init() {
-            flowVelocityField.v.init(gridWidth, gridHeight);
+            flowVelocityField.init(gridWidth, gridHeight);
+            flowStack.reserve(size_t(gridWidth) * gridHeight);
+            openCells.reserve(size_t(gridWidth) * gridHeight);
+            serialMove.stopStack.reserve(size_t(gridWidth) * gridHeight);
+            serialMove.moveStack.reserve(size_t(gridWidth) * gridHeight);
+            serialMove.x1 = gridWidth;
+            serialMove.y1 = gridHeight;
+            blockingSolver.init(gridWidth, gridHeight);
             directionMatrix.init(gridWidth, gridHeight);
             previousPressure.init(gridWidth, gridHeight);
 
+            openNeighbours.init(gridWidth, gridHeight);
+            fullRow.assign(1, {0, gridHeight});
+            activity.init(gridWidth, gridHeight);
+
             densityLevels[' '] = 0.01;
             densityLevels['.'] = 1000ll;
+            buildOpenCells();
+            for (auto [x, y] : openCells) {
+                directionMatrix[x][y] = std::popcount(openNeighbours[x][y]);
+            }
+
+            densityReciprocal[' '] = Reciprocal<PressureType>(densityLevels[' ']);
+            densityReciprocal['.'] = Reciprocal<PressureType>(densityLevels['.']);
+            directionReciprocal.init(gridWidth, gridHeight);
+            pressureMask.init(gridWidth, gridHeight);
             for (int x = 0; x < gridWidth; ++x) {
                 for (int y = 0; y < gridHeight; ++y) {
-                    if (simulationGrid[x][y] == '#')
-                        continue;
-                    for (auto [dx, dy]: deltas) {
-                        directionMatrix[x][y] += (simulationGrid[x + dx][y + dy] != '#');
+                    if (directionMatrix[x][y] > 0) {
+                        directionReciprocal[x][y] = Reciprocal<PressureType>(PressureType(directionMatrix[x][y]));
                     }
                 }
             }
         }
 
-    public:
-        FluidEngine() = default;
+        // openNeighbours and openCells for the whole grid
+        void buildOpenCells() {
+            openCells.clear();
+            for (int x = 0; x < gridWidth; ++x) {
+                for (int y = 0; y < gridHeight; ++y) {
+                    uint8_t open = 0;
+                    for (size_t d = 0; d < deltas.size(); ++d) {
+                        auto [dx, dy] = deltas[d];
+                        int nx = x + dx, ny = y + dy;
+                        if (nx >= 0 && nx < gridWidth && ny >= 0 && ny < gridHeight && simulationGrid[nx][ny] != '#') {
+                            open |= dirBit(d);
+                        }
+                    }
+                    openNeighbours[x][y] = open;
+                    if (simulationGrid[x][y] != '#') {
+                        openCells.emplace_back(x, y);
+                    }
+                }
+            }
+        }
 
-        void next(std::optional<std::reference_wrapper<std::ostream>> out) override {
-            PressureType total_delta_p = 0ll;
+        // Narrows openNeighbours and openCells to the tiles active in this step. A neighbour in a
+        // sleeping tile counts as a wall, so no pass reads or writes outside the active tiles.
+        void narrowToActiveRegion() {
+            activity.beginStep();
+            openCells.clear();
+            for (int x = 0; x < gridWidth; ++x) {
+                for (auto [y0, y1] : activity.spans(x)) {
+                    for (int y = y0; y < y1; ++y) {
+                        if (simulationGrid[x][y] == '#')
+                            continue;
+                        uint8_t open = 0;
+                        for (size_t d = 0; d < deltas.size(); ++d) {
+                            auto [dx, dy] = deltas[d];
+                            int nx = x + dx, ny = y + dy;
+                            if (nx >= 0 && nx < gridWidth && ny >= 0 && ny < gridHeight &&
+                                simulationGrid[nx][ny] != '#' && activity.cellActive(nx, ny)) {
+                                open |= dirBit(d);
+                            }
+                        }
+                        openNeighbours[x][y] = open;
+                        openCells.emplace_back(x, y);
+                    }
+                }
+            }
+            velocitySnapshot.resize(openCells.size());
+            for (size_t i = 0; i < openCells.size(); ++i) {
+                auto [x, y] = openCells[i];
+                for (size_t d = 0; d < deltas.size(); ++d) {
+                    velocitySnapshot[i][d] = velocityField.get(x, y, d);
+                }
+            }
+        }
 
-            // Apply external forces
-            for (size_t x = 0; x < gridWidth; ++x) {
-                for (size_t y = 0; y < gridHeight; ++y) {
-                    if (simulationGrid[x][y] == '#')
-                        continue;
-                    if (simulationGrid[x + 1][y] != '#')
-                        velocityField.add(x, y, 1, 0, g<VelocityType>());
+        // Marks the tiles of active cells whose pressure or velocity moved by more than epsilon.
+        // Swaps mark their cells as they happen, and previousPressure still holds the pressure
+        // from the start of the step, since gravity does not touch it.
+        void markChangedCells() {
+            for (size_t i = 0; i < openCells.size(); ++i) {
+                auto [x, y] = openCells[i];
+                bool changed = fabs(pressure[x][y] - previousPressure[x][y]) > pressureEpsilon;
+                for (size_t d = 0; d < deltas.size() && !changed; ++d) {
+                    changed = fabs(velocityField.get(x, y, d) - velocitySnapshot[i][d]) > velocityEpsilon;
+                }
+                if (changed) {
+                    activity.markCell(x, y);
                 }
             }
+        }
 
-            // Apply forces from pressure
-            previousPressure = pressure;
-            for (size_t x = 0; x < gridWidth; ++x) {
-                for (size_t y = 0; y < gridHeight; ++y) {
-                    if (simulationGrid[x][y] == '#')
-                        continue;
-                    for (auto [dx, dy] : deltas) {
-                        int nx = x + dx, ny = y + dy;
-                        if (simulationGrid[nx][ny] != '#' && previousPressure[nx][ny] < previousPressure[x][y]) {
+        const std::vector<std::pair<int, int>> &rowSpans(int x) const {
+            return activity.enabled() ? activity.spans(x) : fullRow;
+        }
+
+        // Rows [x0, x1) of the two stencil passes. Each face velocity pair is written only by the
+        // endpoint with the higher previous pressure and pressure[x][y] only by its own cell,
+        // so disjoint row bands can run concurrently and give the same result as one sweep.
+        void apply_gravity(int x0, int x1) {
+            for (int x = x0; x < x1; ++x) {
+                if (activity.enabled()) {
+                    // the cell below may be asleep, which only the narrowed mask knows about
+                    for (auto [y0, y1] : activity.spans(x)) {
+                        for (int y = y0; y < y1; ++y) {
+                            if (simulationGrid[x][y] != '#' && (openNeighbours[x][y] & dirBit(Down)))
+                                velocityField.template get<Down>(x, y) += g<VelocityType>();
+                        }
+                    }
+                    continue;
+                }
+                gravityRow(kernelPath, simulationGrid[x], simulationGrid[std::min(x + 1, gridWidth - 1)],
+                           &velocityField.template get<Down>(x, 0), velocityField.cellStride, g<VelocityType>(), 0, gridHeight);
+            }
+        }
+
+        PressureType apply_pressure_forces(int x0, int x1) {
+            PressureType delta_sum = 0ll;
+            for (int x = x0; x < x1; ++x) {
+                int up = std::max(x - 1, 0), down = std::min(x + 1, gridWidth - 1);
+                for (auto [y0, y1] : rowSpans(x)) {
+                    pressureMaskRow(kernelPath, simulationGrid[up], simulationGrid[x], simulationGrid[down],
+                                    previousPressure[up], previousPressure[x], previousPressure[down],
+                                    y0, y1, gridHeight, pressureMask[x]);
+                    for (int y = y0; y < y1; ++y) {
+                        for (unsigned bits = pressureMask[x][y] & openNeighbours[x][y]; bits != 0; bits &= bits - 1) {
+                            size_t d = std::countr_zero(bits);
+                            auto [dx, dy] = deltas[d];
+                            int nx = x + dx, ny = y + dy;
                             PressureType delta_p = previousPressure[x][y] - previousPressure[nx][ny];
                             PressureType force = delta_p;
-                            VelocityType &contr = velocityField.get(nx, ny, -dx, -dy);
+                            VelocityType &contr = velocityField.get(nx, ny, opposite(d));
                             if (PressureType(contr) * densityLevels[(int) simulationGrid[nx][ny]] >= force) {
-                                contr -= VelocityType(force / densityLevels[(int) simulationGrid[nx][ny]]);
+                                contr -= VelocityType(densityReciprocal[(int) simulationGrid[nx][ny]].divide(force));
                                 continue;
                             }
                             force -= PressureType(contr) * densityLevels[(int) simulationGrid[nx][ny]];
                             contr = 0ll;
-                            velocityField.add(x, y, dx, dy, VelocityType(force / densityLevels[(int) simulationGrid[x][y]]));
-                            pressure[x][y] -= force / directionMatrix[x][y];
-                            total_delta_p -= force / directionMatrix[x][y];
+                            velocityField.add(x, y, d, VelocityType(densityReciprocal[(int) simulationGrid[x][y]].divide(force)));
+                            PressureType share = directionReciprocal[x][y].divide(force);
+                            pressure[x][y] -= share;
+                            delta_sum -= share;
                         }
                     }
                 }
             }
+            return delta_sum;
+        }
 
-            // Make flow from velocities
-            flowVelocityField = {};
+        FlowStats make_flow_dfs() {
+            FlowStats flowStats;
+            flowDepth = 1;
             bool prop = false;
             do {
                 updateTimestamp += 2;
                 prop = false;
-                for (size_t x = 0; x < gridWidth; ++x) {
-                    for (size_t y = 0; y < gridHeight; ++y) {
-                        if (simulationGrid[x][y] != '#' && lastUsage[x][y] != updateTimestamp) {
-                            auto [t, local_prop, _] = propagate_flow(x, y, 1ll);
-                            if (t > 0ll) {
-                                prop = true;
-                            }
+                ++flowStats.iterations;
+                for (auto [x, y] : openCells) {
+                    if (lastUsage[x][y] != updateTimestamp) {
+                        auto [t, local_prop, _] = propagate_flow(x, y, 1ll);
+                        if (t > 0ll) {
+                            prop = true;
+                            ++flowStats.augmentingPaths;
                         }
                     }
                 }
             } while (prop);
+            flowStats.maxDepth = flowDepth;
+            return flowStats;
+        }
 
-            // Recalculate pressure with kinetic energy
-            for (size_t x = 0; x < gridWidth; ++x) {
-                for (size_t y = 0; y < gridHeight; ++y) {
-                    if (simulationGrid[x][y] == '#')
-                        continue;
-                    for (auto [dx, dy] : deltas) {
-                        VelocityType old_v = velocityField.get(x, y, dx, dy);
-                        FlowVelocityType new_v = flowVelocityField.get(x, y, dx, dy);
-                        if (old_v > 0ll) {
-                            assert(VelocityType(new_v) <= old_v);
-
-                            velocityField.get(x, y, dx, dy) = VelocityType(new_v);
-                            auto force = PressureType(old_v - VelocityType(new_v)) * densityLevels[(int) simulationGrid[x][y]];
-                            if (simulationGrid[x][y] == '.')
-                                force *= 0.8;
-                            if (simulationGrid[x + dx][y + dy] == '#') {
-                                pressure[x][y] += force / directionMatrix[x][y];
-                                total_delta_p += force / directionMatrix[x][y];
-                            } else {
-                                pressure[x + dx][y + dy] += force / directionMatrix[x + dx][y + dy];
-                                total_delta_p += force / directionMatrix[x + dx][y + dy];
+        // One root of the movement phase: a random draw picks between moving and stopping
+        bool move_from(MoveScope &scope, int x, int y) {
+            if (random01(x, y, 0) < move_prob(scope, x, y)) {
+                propagate_move(scope, x, y, true);
+                return true;
+            }
+            propagate_stop(scope, x, y, true);
+            return false;
+        }
+
+        bool move_serial() {
+            serialMove.swaps = 0;
+            serialMove.maxDepth = 0;
+            bool prop = false;
+            for (auto [x, y] : openCells) {
+                if (lastUsage[x][y] != updateTimestamp) {
+                    prop |= move_from(serialMove, x, y);
+                }
+            }
+            return prop;
+        }
+
+        // Owner-computes movement over a 2x2 checkerboard of moveTile tiles. The four colours run
+        // one after another and the tiles of one colour concurrently. A tile starts traversals
+        // from its own cells in row-major order and they may reach half a tile past its edges,
+        // so tiles of one colour never touch the same cell and the result does not depend on the
+        // thread count. The tiling shifts by half a tile every other step so that seams move.
+        bool move_parallel() {
+            for (auto &scope : parallelMove) {
+                scope.swaps = 0;
+                scope.maxDepth = 0;
+            }
+            const int half = moveTile / 2;
+            const int shift = (updateTimestamp / 2) % 2 ? half : 0;
+            bool prop = false;
+            for (int color = 0; color < 4; ++color) {
+                moveTiles.clear();
+                for (int tx = color / 2; tx * moveTile - shift < gridWidth; tx += 2) {
+                    for (int ty = color % 2; ty * moveTile - shift < gridHeight; ty += 2) {
+                        moveTiles.emplace_back(tx * moveTile - shift, ty * moveTile - shift);
+                    }
+                }
+                movedInChunk.assign(parallelMove.size(), 0);
+                auto body = [this, half](int from, int to, int chunk) {
+                    MoveScope &scope = parallelMove[chunk];
+                    for (int i = from; i < to; ++i) {
+                        auto [ox, oy] = moveTiles[i];
+                        scope.x0 = std::max(ox - half, 0);
+                        scope.x1 = std::min(ox + moveTile + half, gridWidth);
+                        scope.y0 = std::max(oy - half, 0);
+                        scope.y1 = std::min(oy + moveTile + half, gridHeight);
+                        for (int x = std::max(ox, 0); x < std::min(ox + moveTile, gridWidth); ++x) {
+                            for (int y = std::max(oy, 0); y < std::min(oy + moveTile, gridHeight); ++y) {
+                                if (simulationGrid[x][y] != '#' && lastUsage[x][y] != updateTimestamp &&
+                                    (!activity.enabled() || activity.cellActive(x, y))) {
+                                    movedInChunk[chunk] |= move_from(scope, x, y);
+                                }
                             }
                         }
                     }
+                };
+                if (pool) {
+                    pool->parallelFor(0, int(moveTiles.size()), body);
+                } else {
+                    body(0, int(moveTiles.size()), 0);
+                }
+                for (char moved : movedInChunk) {
+                    prop |= moved != 0;
                 }
             }
+            return prop;
+        }
 
-            updateTimestamp += 2;
-            prop = false;
-            for (size_t x = 0; x < gridWidth; ++x) {
-                for (size_t y = 0; y < gridHeight; ++y) {
-                    if (simulationGrid[x][y] != '#' && lastUsage[x][y] != updateTimestamp) {
-                        if (random01<VelocityType>() < move_prob(x, y)) {
-                            prop = true;
-                            propagate_move(x, y, true);
-                        } else {
-                            propagate_stop(x, y, true);
+        // One scope per worker; a traversal never holds more cells than its region
+        void resizeMoveScopes() {
+            parallelMove.resize(parallelMovement ? (pool ? pool->size() : 1) : 0);
+            for (auto &scope : parallelMove) {
+                scope.stopStack.reserve(size_t(2 * moveTile) * (2 * moveTile));
+                scope.moveStack.reserve(size_t(2 * moveTile) * (2 * moveTile));
+            }
+        }
+
+        template<typename F>
+        void forEachRowBand(F &&body) {
+            if (pool) {
+                pool->parallelFor(0, gridWidth, body);
+            } else {
+                body(0, gridWidth, 0);
+            }
+        }
+
+    public:
+        FluidEngine() = default;
+
+        void setThreadCount(int threads) override {
+            if (threads <= 0) {
+                throw std::invalid_argument("Thread count must be positive");
+            }
+            pool = threads > 1 ? std::make_unique<ThreadPool>(threads) : nullptr;
+            resizeMoveScopes();
+        }
+
+        void setFlowSolver(FlowSolverKind kind) override {
+            flowSolver = kind;
+        }
+
+        void setFrameMode(FrameMode mode, int every) override {
+            frameWriter = FrameWriter(mode, every);
+        }
+
+        void setKernelPath(KernelPath path) override {
+            kernelPath = resolveKernelPath(path);
+        }
+
+        void setRandom(RngKind kind, uint64_t seed) override {
+            if (parallelMovement && kind != RngKind::Philox) {
+                throw std::invalid_argument("Parallel movement needs the philox generator");
+            }
+            random.configure(kind, seed);
+        }
+
+        void setParallelMovement(bool on) override {
+            if (on && random.kind() != RngKind::Philox) {
+                throw std::invalid_argument("Parallel movement needs the philox generator");
+            }
+            parallelMovement = on;
+            resizeMoveScopes();
+        }
+
+        void setActiveEpsilon(double epsilon) override {
+            if (epsilon < 0) {
+                throw std::invalid_argument("Active-region epsilon must not be negative");
+            }
+            bool wasEnabled = activity.enabled();
+            activity.setEpsilon(epsilon);
+            pressureEpsilon = PressureType(epsilon);
+            velocityEpsilon = VelocityType(epsilon);
+            if (wasEnabled && !activity.enabled()) {
+                // openNeighbours and openCells still hold the last narrowed step
+                buildOpenCells();
+            }
+        }
+
+        double activeFraction() const override {
+            return activity.enabled() ? activity.activeFraction() : 1.0;
+        }
+
+        void enableProfiling(bool on) override {
+            profiler.enable(on);
+        }
+
+        void reportProfile(std::ostream &out) const override {
+            profiler.report(out);
+        }
+
+        const StepStats &lastStepStats() const override {
+            return stats;
+        }
+
+        void reset() override {
+            // load() overwrites the grid, lastUsage, pressure and velocity; init() only rebuilds
+            // the derived arrays for open cells, so clear what a fresh engine has zeroed
+            flowVelocityField.clear();
+            previousPressure.fill({});
+            directionMatrix.fill(0);
+            openNeighbours.fill(0);
+            directionReciprocal.fill({});
+            pressureMask.fill(0);
+            updateTimestamp = 0;
+
+            pool.reset();
+            flowSolver = FlowSolverKind::Dfs;
+            kernelPath = resolveKernelPath(KernelPath::Auto);
+            random = EngineRandom{};
+            parallelMovement = false;
+            resizeMoveScopes();
+            activity = ActiveRegion{};
+            pressureEpsilon = {};
+            velocityEpsilon = {};
+            frameWriter = FrameWriter{};
+            profiler = StepProfiler{};
+            stats = StepStats{};
+        }
+
+        std::pair<int, int> gridSize() const override {
+            return {gridWidth, gridHeight};
+        }
+
+        size_t memoryUsage() const override {
+            auto vectorBytes = []<typename T>(const std::vector<T> &vec) {
+                return vec.capacity() * sizeof(T);
+            };
+            size_t bytes = sizeof(*this);
+            bytes += simulationGrid.heapBytes() + velocityField.heapBytes() + flowVelocityField.heapBytes();
+            bytes += pressure.heapBytes() + previousPressure.heapBytes() + directionMatrix.heapBytes();
+            bytes += openNeighbours.heapBytes() + lastUsage.heapBytes() + directionReciprocal.heapBytes();
+            bytes += pressureMask.heapBytes();
+            bytes += vectorBytes(openCells) + vectorBytes(velocitySnapshot) + vectorBytes(flowStack);
+            bytes += vectorBytes(bandDeltas) + vectorBytes(moveTiles) + vectorBytes(movedInChunk);
+            bytes += vectorBytes(serialMove.stopStack) + vectorBytes(serialMove.moveStack);
+            for (auto &scope : parallelMove) {
+                bytes += sizeof(scope) + vectorBytes(scope.stopStack) + vectorBytes(scope.moveStack);
+            }
+            return bytes + blockingSolver.heapBytes();
+        }
+
+        FrameLayout frameLayout() const override {
+            return FrameLayout{gridWidth, gridHeight, typeCodeOf<PressureType>, typeCodeOf<VelocityType>,
+                               sizeof(PressureType), sizeof(VelocityType)};
+        }
+
+        void captureFrame(uint32_t fields, std::vector<char> &raw) const override {
+            raw.resize(frameLayout().frameBytes(fields));
+            char *dst = raw.data();
+            auto copyArray = [&]<typename T, int gridWidth, int gridHeight>(const Array<T, gridWidth, gridHeight>& arr) {
+                for (int i = 0; i < this->gridWidth; ++i) {
+                    std::memcpy(dst, arr[i], sizeof(T) * this->gridHeight);
+                    dst += sizeof(T) * this->gridHeight;
+                }
+            };
+
+            if (fields & RecordGrid) {
+                copyArray(simulationGrid);
+            }
+            if (fields & RecordPressure) {
+                copyArray(pressure);
+            }
+            if (fields & RecordVelocity) {
+                if constexpr (VelocityLayout == FieldLayout::AoS) {
+                    copyArray(velocityField.v);
+                } else {
+                    for (int i = 0; i < gridWidth; ++i) {
+                        for (int j = 0; j < gridHeight; ++j) {
+                            for (size_t d = 0; d < deltas.size(); ++d) {
+                                std::memcpy(dst, &velocityField.planes[d][i][j], sizeof(VelocityType));
+                                dst += sizeof(VelocityType);
+                            }
                         }
                     }
                 }
             }
+        }
 
-            if (prop && out) {
-                for (int i = 0; i < gridWidth; ++i) {
-                    for (int j = 0; j < gridHeight; ++j) {
-                        out->get() << simulationGrid[i][j];
+        void next(std::optional<std::reference_wrapper<std::ostream>> out) override {
+            PressureType total_delta_p = 0ll;
+            profiler.start();
+
+            if (activity.enabled()) {
+                narrowToActiveRegion();
+            }
+
+            // Apply external forces
+            forEachRowBand([this](int x0, int x1, int) {
+                apply_gravity(x0, x1);
+            });
+            profiler.lap(Phase::Gravity);
+
+            // Apply forces from pressure
+            previousPressure = pressure;
+            bandDeltas.assign(pool ? pool->size() : 1, PressureType(0ll));
+            forEachRowBand([this](int x0, int x1, int band) {
+                bandDeltas[band] = apply_pressure_forces(x0, x1);
+            });
+            for (auto delta : bandDeltas) {
+                total_delta_p += delta;
+            }
+            profiler.lap(Phase::PressureForces);
+
+            // Make flow from velocities
+            flowVelocityField.clear();
+            const FlowStats flowStats = flowSolver == FlowSolverKind::Blocking
+                    ? blockingSolver.solve(openNeighbours, openCells, velocityField, flowVelocityField)
+                    : make_flow_dfs();
+            profiler.lap(Phase::Flow);
+
+            // Recalculate pressure with kinetic energy
+            for (auto [x, y] : openCells) {
+                const unsigned open = openNeighbours[x][y];
+                for (size_t d = 0; d < deltas.size(); ++d) {
+                    auto [dx, dy] = deltas[d];
+                    VelocityType old_v = velocityField.get(x, y, d);
+                    FlowVelocityType new_v = flowVelocityField.get(x, y, d);
+                    if (old_v > 0ll) {
+                        assert(VelocityType(new_v) <= old_v);
+
+                        velocityField.get(x, y, d) = VelocityType(new_v);
+                        auto force = PressureType(old_v - VelocityType(new_v)) * densityLevels[(int) simulationGrid[x][y]];
+                        if (simulationGrid[x][y] == '.')
+                            force *= 0.8;
+                        if (!(open & dirBit(d))) {
+                            PressureType share = directionReciprocal[x][y].divide(force);
+                            pressure[x][y] += share;
+                            total_delta_p += share;
+                        } else {
+                            PressureType share = directionReciprocal[x + dx][y + dy].divide(force);
+                            pressure[x + dx][y + dy] += share;
+                            total_delta_p += share;
+                        }
                     }
-                    out->get() << std::endl;
                 }
-                std::cout.flush();
             }
+
+            profiler.lap(Phase::KineticEnergy);
+
+            updateTimestamp += 2;
+            bool prop = parallelMovement ? move_parallel() : move_serial();
+
+            if (activity.enabled()) {
+                markChangedCells();
+            }
+            profiler.lap(Phase::Movement);
+
+            if (prop && out) {
+                frameWriter.write(out->get(), simulationGrid.data(), gridWidth, gridHeight, simulationGrid.stride);
+            }
+            profiler.lap(Phase::Output);
+
+            stats = StepStats{};
+            for (const MoveScope &scope : parallelMovement ? std::span(parallelMove) : std::span(&serialMove, 1)) {
+                stats.movedCells += scope.swaps;
+                stats.moveDepth = std::max(stats.moveDepth, scope.maxDepth);
+            }
+            stats.totalDeltaP = double(total_delta_p);
+            stats.flowIterations = flowStats.iterations;
+            stats.augmentingPaths = flowStats.augmentingPaths;
+            stats.flowDepth = flowStats.maxDepth;
+            stats.phaseNs = profiler.lastStep();
         }
 
-        void load(std::ifstream& file) override {
+        void load(const MappedFile &file) override {
+            TextScanner in(file);
             auto loadArray = [&]<typename T, int gridWidth, int gridHeight>(Array<T, gridWidth, gridHeight>& arr, int n, int m) {
                 arr.init(n, m);
-                for (int i = 0; i < arr.gridWidth; ++i) {
-                    for (int j = 0; j < arr.gridHeight; ++j) {
-                        if constexpr (std::is_same_v<T, char>) {
-                            char tmp;
-                            do {
-                                file.get(tmp);
-                            } while (tmp == '\n');
-//                            file >> tmp;
-                            arr[i][j] = static_cast<char>(tmp);
-                        } else {
-                            double tmp = 0;
-                            file >> tmp;
-                            arr[i][j] = tmp;
+                for (int i = 0; i < n; ++i) {
+                    if constexpr (std::is_same_v<T, char>) {
+                        in.cells(arr[i], m);
+                    } else {
+                        for (int j = 0; j < m; ++j) {
+                            arr[i][j] = in.template number<double>();
                         }
                     }
                 }
             };
 
-            auto loadArrayOfArrays = [&]<typename T, int gridWidth, int gridHeight>(Array<std::array<T, 4>, gridWidth, gridHeight>& arr, int n, int m){
-                arr.init(n, m);
-                for (int i = 0; i < arr.gridWidth; ++i) {
-                    for (int j = 0; j < arr.gridHeight; ++j) {
-                        double tmp[4] = {0};
-                        file >> tmp[0] >> tmp[1] >> tmp[2] >> tmp[3];
-                        arr[i][j] = {T(tmp[0]), T(tmp[1]), T(tmp[2]), T(tmp[3])};
+            auto loadVectorField = [&]<typename T, int gridWidth, int gridHeight, FieldLayout Layout>(VectorField<T, gridWidth, gridHeight, Layout>& field, int n, int m){
+                field.init(n, m);
+                for (int i = 0; i < n; ++i) {
+                    for (int j = 0; j < m; ++j) {
+                        for (size_t d = 0; d < deltas.size(); ++d) {
+                            field.get(i, j, d) = T(in.template number<double>());
+                        }
                     }
                 }
             };
 
-
-            if (!file.is_open()) {
-                throw std::invalid_argument("File is not opened");
+            gridWidth = in.number<int>();
+            gridHeight = in.number<int>();
+            updateTimestamp = in.number<int>();
+            if (gridWidth <= 0 || gridHeight <= 0) {
+                throw std::invalid_argument("Text checkpoint has no cells");
+            }
+            if (Width != -1 && (gridWidth != Width || gridHeight != Height)) {
+                throw std::invalid_argument("Checkpoint size does not match the engine size");
             }
-            file >> gridWidth >> gridHeight >> updateTimestamp;
             loadArray(simulationGrid, gridWidth, gridHeight);
             loadArray(lastUsage, gridWidth, gridHeight);
             loadArray(pressure, gridWidth, gridHeight);
-            loadArrayOfArrays(velocityField.v, gridWidth, gridHeight);
+            loadVectorField(velocityField, gridWidth, gridHeight);
             init();
         }
 
-        void save(std::ofstream &file) override {
+        void save(std::ostream &file) override {
             auto saveArray = [&]<typename T, int gridWidth, int gridHeight>(Array<T, gridWidth, gridHeight>& arr) {
                 for (int i = 0; i < arr.gridWidth; ++i) {
                     for (int j = 0; j < arr.gridHeight; ++j) {
@@ -379,23 +957,112 @@ namespace FluidPhysics {
                 }
             };
 
-            auto saveArrayOfArrays = [&]<typename T, int gridWidth, int gridHeight>(Array<std::array<T, 4>, gridWidth, gridHeight>& arr){
-                for (int i = 0; i < arr.gridWidth; ++i) {
-                    for (int j = 0; j < arr.gridHeight; ++j) {
-                        file << arr[i][j][0] << " " << arr[i][j][1] << " " << arr[i][j][2] << " " << arr[i][j][3];
+            auto saveVectorField = [&]<typename T, int gridWidth, int gridHeight, FieldLayout Layout>(VectorField<T, gridWidth, gridHeight, Layout>& field){
+                for (int i = 0; i < this->gridWidth; ++i) {
+                    for (int j = 0; j < this->gridHeight; ++j) {
+                        file << field.template get<Up>(i, j) << " " << field.template get<Down>(i, j) << " "
+                             << field.template get<Left>(i, j) << " " << field.template get<Right>(i, j) << " ";
                     }
                     file << std::endl;
                 }
             };
 
-            if (!file.is_open()) {
+            if (!file) {
                 throw std::invalid_argument("File is not opened");
             }
             file << gridWidth << " " << gridHeight << " " << updateTimestamp << std::endl;
             saveArray(simulationGrid);
             saveArray(lastUsage);
             saveArray(pressure);
-            saveArrayOfArrays(velocityField.v);
+            saveVectorField(velocityField);
+        }
+
+        void copyStateTo(std::unique_ptr<IEngine> &staging) const override {
+            auto *dst = dynamic_cast<FluidEngine *>(staging.get());
+            if (dst == nullptr) {
+                staging = std::make_unique<FluidEngine>();
+                dst = static_cast<FluidEngine *>(staging.get());
+            }
+            dst->gridWidth = gridWidth;
+            dst->gridHeight = gridHeight;
+            dst->updateTimestamp = updateTimestamp;
+            dst->simulationGrid = simulationGrid;
+            dst->lastUsage = lastUsage;
+            dst->pressure = pressure;
+            dst->velocityField = velocityField;
+        }
+
+        void loadBinary(const MappedFile &file) override {
+            CheckpointHeader header = readCheckpointHeader(file);
+            if (header.pTypeCode != typeCodeOf<PressureType> || header.vTypeCode != typeCodeOf<VelocityType> ||
+                header.vFlowTypeCode != typeCodeOf<FlowVelocityType> ||
+                header.pSize != sizeof(PressureType) || header.vSize != sizeof(VelocityType)) {
+                throw std::invalid_argument("Checkpoint was written by an engine with different types");
+            }
+            if (Width != -1 && (header.width != Width || header.height != Height)) {
+                throw std::invalid_argument("Checkpoint size does not match the engine size");
+            }
+
+            const char *src = file.data() + header.headerSize;
+            auto loadArray = [&]<typename T, int gridWidth, int gridHeight>(Array<T, gridWidth, gridHeight>& arr, int n, int m) {
+                arr.init(n, m);
+                for (int i = 0; i < n; ++i) {
+                    std::memcpy(arr[i], src, sizeof(T) * m);
+                    src += sizeof(T) * m;
+                }
+            };
+
+            gridWidth = header.width;
+            gridHeight = header.height;
+            updateTimestamp = header.updateTimestamp;
+            loadArray(simulationGrid, gridWidth, gridHeight);
+            loadArray(lastUsage, gridWidth, gridHeight);
+            loadArray(pressure, gridWidth, gridHeight);
+            if constexpr (VelocityLayout == FieldLayout::AoS) {
+                loadArray(velocityField.v, gridWidth, gridHeight);
+            } else {
+                velocityField.init(gridWidth, gridHeight);
+                for (int i = 0; i < gridWidth; ++i) {
+                    for (int j = 0; j < gridHeight; ++j) {
+                        for (size_t d = 0; d < deltas.size(); ++d) {
+                            std::memcpy(&velocityField.get(i, j, d), src, sizeof(VelocityType));
+                            src += sizeof(VelocityType);
+                        }
+                    }
+                }
+            }
+            init();
+        }
+
+        void saveBinary(std::ostream &file) override {
+            static_assert(sizeof(int) == sizeof(int32_t), "lastUsage is stored as int32");
+            CheckpointHeader header = makeCheckpointHeader<PressureType, VelocityType, FlowVelocityType>(
+                    gridWidth, gridHeight, updateTimestamp);
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+            auto saveArray = [&]<typename T, int gridWidth, int gridHeight>(Array<T, gridWidth, gridHeight>& arr) {
+                for (int i = 0; i < this->gridWidth; ++i) {
+                    file.write(reinterpret_cast<const char *>(arr[i]), sizeof(T) * this->gridHeight);
+                }
+            };
+
+            saveArray(simulationGrid);
+            saveArray(lastUsage);
+            saveArray(pressure);
+            if constexpr (VelocityLayout == FieldLayout::AoS) {
+                saveArray(velocityField.v);
+            } else {
+                for (int i = 0; i < gridWidth; ++i) {
+                    for (int j = 0; j < gridHeight; ++j) {
+                        for (size_t d = 0; d < deltas.size(); ++d) {
+                            file.write(reinterpret_cast<const char *>(&velocityField.get(i, j, d)), sizeof(VelocityType));
+                        }
+                    }
+                }
+            }
+            if (!file) {
+                throw std::runtime_error("Failed to write checkpoint");
+            }
         }
     };
 }
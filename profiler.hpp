@@ -0,0 +1,178 @@
+#ifndef FLUIDFINALVER_PROFILER_H
+#define FLUIDFINALVER_PROFILER_H
+
+#include <array>
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+#include <string>
+
+namespace FluidPhysics {
+
+    enum class Phase {
+        Gravity,
+        PressureForces,
+        Flow,
+        KineticEnergy,
+        Movement,
+        Output,
+        Count,
+    };
+
+    constexpr std::array<const char *, size_t(Phase::Count)> phaseNames{
+            "gravity", "pressure forces", "flow", "kinetic energy", "movement", "output"};
+
+    // Totals of the last step, kept by every engine whether or not it is profiled
+    struct StepStats {
+        uint64_t movedCells = 0;      // cells that swapped places with a neighbour
+        double totalDeltaP = 0;       // pressure change from the pressure-force and kinetic passes
+        uint64_t flowIterations = 0;  // passes of the flow search over the open cells
+        uint64_t augmentingPaths = 0; // cycles along which flow was pushed
+        uint64_t flowDepth = 0;       // deepest flow search stack
+        uint64_t moveDepth = 0;       // deepest movement traversal stack
+        std::array<uint64_t, size_t(Phase::Count)> phaseNs{};
+    };
+
+    // One CSV row per step, for runs that are monitored without parsing the frames
+    inline void writeStepStatsHeader(std::ostream &out) {
+        out << "step,moved_cells,total_delta_p,flow_iterations,augmenting_paths,flow_depth,move_depth";
+        for (const char *name : phaseNames) {
+            std::string column = name;
+            std::replace(column.begin(), column.end(), ' ', '_');
+            out << "," << column << "_ns";
+        }
+        out << "\n";
+    }
+
+    inline void writeStepStats(std::ostream &out, long long step, const StepStats &stats) {
+        out << step << "," << stats.movedCells << "," << stats.totalDeltaP << "," << stats.flowIterations << ","
+            << stats.augmentingPaths << "," << stats.flowDepth << "," << stats.moveDepth;
+        for (uint64_t ns : stats.phaseNs) {
+            out << "," << ns;
+        }
+        out << "\n";
+    }
+
+    // Per-phase step timing. start() at the beginning of a step and lap(phase) at the end of each
+    // phase cost one steady_clock read each, which is what the per-step timings in StepStats need;
+    // the totals and histograms are only gathered while the profiler is enabled.
+    class StepProfiler {
+    public:
+        static constexpr int bucketCount = 40;
+
+        struct PhaseStats {
+            uint64_t count = 0;
+            uint64_t totalNs = 0;
+            uint64_t minNs = std::numeric_limits<uint64_t>::max();
+            uint64_t maxNs = 0;
+            // bucket b counts laps that took [2^b, 2^(b+1)) ns
+            std::array<uint64_t, bucketCount> histogram{};
+        };
+
+        void enable(bool on) {
+            enabled_ = on;
+        }
+
+        bool enabled() const {
+            return enabled_;
+        }
+
+        void start() {
+            last_ = std::chrono::steady_clock::now();
+        }
+
+        void lap(Phase phase) {
+            auto now = std::chrono::steady_clock::now();
+            auto ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_).count());
+            last_ = now;
+            lastNs_[size_t(phase)] = ns;
+            if (!enabled_) {
+                return;
+            }
+            PhaseStats &s = stats_[size_t(phase)];
+            ++s.count;
+            s.totalNs += ns;
+            s.minNs = std::min(s.minNs, ns);
+            s.maxNs = std::max(s.maxNs, ns);
+            ++s.histogram[std::min<int>(bucketCount - 1, std::bit_width(ns | 1) - 1)];
+        }
+
+        // Durations of the phases of the last step
+        const std::array<uint64_t, size_t(Phase::Count)> &lastStep() const {
+            return lastNs_;
+        }
+
+        const PhaseStats &stats(Phase phase) const {
+            return stats_[size_t(phase)];
+        }
+
+        void report(std::ostream &out) const {
+            uint64_t total = 0;
+            for (const auto &s : stats_) {
+                total += s.totalNs;
+            }
+            out << "\nPhase timings (" << stats_[0].count << " steps, "
+                << std::fixed << std::setprecision(3) << total / 1e6 << " ms total)\n";
+            out << std::left << std::setw(18) << "phase" << std::right
+                << std::setw(12) << "total ms" << std::setw(8) << "share"
+                << std::setw(12) << "mean us" << std::setw(12) << "min us" << std::setw(12) << "max us" << "\n";
+            for (size_t p = 0; p < stats_.size(); ++p) {
+                const PhaseStats &s = stats_[p];
+                if (s.count == 0) {
+                    continue;
+                }
+                out << std::left << std::setw(18) << phaseNames[p] << std::right
+                    << std::setw(12) << s.totalNs / 1e6
+                    << std::setw(7) << std::setprecision(1) << (total ? 100.0 * s.totalNs / total : 0.0) << "%"
+                    << std::setprecision(3)
+                    << std::setw(12) << s.totalNs / 1e3 / s.count
+                    << std::setw(12) << s.minNs / 1e3
+                    << std::setw(12) << s.maxNs / 1e3 << "\n";
+            }
+            for (size_t p = 0; p < stats_.size(); ++p) {
+                const PhaseStats &s = stats_[p];
+                if (s.count == 0) {
+                    continue;
+                }
+                out << "\n" << phaseNames[p] << " histogram\n";
+                uint64_t peak = *std::max_element(s.histogram.begin(), s.histogram.end());
+                for (int b = 0; b < bucketCount; ++b) {
+                    if (s.histogram[b] == 0) {
+                        continue;
+                    }
+                    out << std::setw(12) << formatNs(uint64_t(1) << b) << " "
+                        << std::setw(8) << s.histogram[b] << " "
+                        << std::string(size_t(1 + 39 * s.histogram[b] / peak), '#') << "\n";
+                }
+            }
+            out.unsetf(std::ios::floatfield);
+            out << std::setprecision(6);
+        }
+
+    private:
+        static std::string formatNs(uint64_t ns) {
+            if (ns >= 1000000000) {
+                return ">=" + std::to_string(ns / 1000000000) + "s";
+            }
+            if (ns >= 1000000) {
+                return ">=" + std::to_string(ns / 1000000) + "ms";
+            }
+            if (ns >= 1000) {
+                return ">=" + std::to_string(ns / 1000) + "us";
+            }
+            return ">=" + std::to_string(ns) + "ns";
+        }
+
+        bool enabled_ = false;
+        std::chrono::steady_clock::time_point last_{};
+        std::array<PhaseStats, size_t(Phase::Count)> stats_{};
+        std::array<uint64_t, size_t(Phase::Count)> lastNs_{};
+    };
+
+}
+
+#endif //FLUIDFINALVER_PROFILER_H
@@ -1,19 +1,72 @@
 #ifndef FLUIDFINALVER_RANDOM_H
 #define FLUIDFINALVER_RANDOM_H
 
+#include <array>
+#include <cstdint>
 #include <random>
+#include <type_traits>
 
 namespace FluidPhysics {
-    std::mt19937 rnd(1337);
 
+    enum class RngKind {
+        Mt19937, // one sequential stream per engine, the reference results
+        Philox,  // counter-based: every draw is a pure function of (seed, step, cell, stream)
+    };
+
+    // Philox4x32-10 from Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"
+    constexpr std::array<uint32_t, 4> philox4x32(std::array<uint32_t, 4> ctr, std::array<uint32_t, 2> key) {
+        constexpr uint64_t m0 = 0xD2511F53, m1 = 0xCD9E8D57;
+        constexpr uint32_t w0 = 0x9E3779B9, w1 = 0xBB67AE85;
+        for (int round = 0; round < 10; ++round) {
+            uint64_t p0 = m0 * ctr[0];
+            uint64_t p1 = m1 * ctr[2];
+            ctr = {uint32_t(p1 >> 32) ^ ctr[1] ^ key[0], uint32_t(p1),
+                   uint32_t(p0 >> 32) ^ ctr[3] ^ key[1], uint32_t(p0)};
+            key = {key[0] + w0, key[1] + w1};
+        }
+        return ctr;
+    }
+
+    // Maps 32 random bits to [0, 1) the way the global std::mt19937 draws used to
     template<typename T>
-    T random01() {
+    T unitFromBits(uint32_t bits) {
         if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>) {
-            return T(rnd()) / T(std::mt19937::max());
+            return T(bits) / T(std::mt19937::max());
         } else {
-            return T::from_raw((rnd() & ((1ll << T::k) - 1ll)));
+            return T::from_raw((bits & ((1ll << T::k) - 1ll)));
         }
     }
+
+    // Per-engine random source. With Philox a draw depends only on its key, so any cell's draw
+    // can be made independently of the others and the results do not depend on visiting order.
+    class EngineRandom {
+    public:
+        static constexpr uint64_t defaultSeed = 1337;
+
+        void configure(RngKind kind, uint64_t seed) {
+            kind_ = kind;
+            seed_ = seed;
+            mt_.seed(std::mt19937::result_type(seed));
+        }
+
+        RngKind kind() const {
+            return kind_;
+        }
+
+        // step and cell identify the draw, stream tells apart several draws of one cell in a step
+        template<typename T>
+        T random01(uint32_t step, uint32_t cell, uint32_t stream) {
+            if (kind_ == RngKind::Philox) {
+                return unitFromBits<T>(philox4x32({cell, stream, step, 0}, {uint32_t(seed_), uint32_t(seed_ >> 32)})[0]);
+            }
+            return unitFromBits<T>(uint32_t(mt_()));
+        }
+
+    private:
+        RngKind kind_ = RngKind::Mt19937;
+        uint64_t seed_ = defaultSeed;
+        std::mt19937 mt_{std::mt19937::result_type(defaultSeed)};
+    };
 }
 
 #endif //FLUIDFINALVER_RANDOM_H
@@ -0,0 +1,361 @@
+#ifndef FLUIDFINALVER_RECORDING_H
+#define FLUIDFINALVER_RECORDING_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "checkpoint.hpp"
+
+namespace FluidPhysics {
+
+    // Fields a recording keeps for every step, as a bit mask
+    enum RecordField : uint32_t {
+        RecordGrid = 1,
+        RecordPressure = 2,
+        RecordVelocity = 4,
+    };
+
+    // Shape and types of the engine being recorded, so that a replay needs no engine
+    struct FrameLayout {
+        int32_t width = 0;
+        int32_t height = 0;
+        int32_t pTypeCode = 0;
+        int32_t vTypeCode = 0;
+        uint32_t pSize = 0;
+        uint32_t vSize = 0;
+
+        // Raw frame: the selected fields one after another, each width * height cells in
+        // row-major order like a binary checkpoint (4 velocities per cell in deltas order)
+        size_t frameBytes(uint32_t fields) const {
+            size_t cells = size_t(width) * height;
+            return ((fields & RecordGrid) ? cells : 0) + ((fields & RecordPressure) ? cells * pSize : 0) +
+                   ((fields & RecordVelocity) ? cells * 4 * size_t(vSize) : 0);
+        }
+
+        // Offset of a field inside the raw frame
+        size_t fieldOffset(uint32_t fields, RecordField field) const {
+            size_t cells = size_t(width) * height;
+            size_t offset = 0;
+            if (field == RecordGrid) {
+                return offset;
+            }
+            offset += (fields & RecordGrid) ? cells : 0;
+            if (field == RecordPressure) {
+                return offset;
+            }
+            return offset + ((fields & RecordPressure) ? cells * pSize : 0);
+        }
+    };
+
+    constexpr char recordingMagic[8] = {'F', 'L', 'U', 'I', 'D', 'R', 'E', 'C'};
+    constexpr char recordingIndexMagic[8] = {'F', 'L', 'U', 'I', 'D', 'I', 'D', 'X'};
+    constexpr uint32_t recordingVersion = 1;
+
+    // Recording layout, native byte order:
+    //   header, then the encoded frames in chunks of keyframeEvery frames, then the frame index
+    //   (one RecordingIndexEntry per frame) and the footer that points at it.
+    // A frame is the byte-wise XOR of its raw bytes with the previous frame's (with zeros for a
+    // keyframe), run-length encoded: tokens "varint (length << 1 | isRun)" followed by one byte
+    // for a run or length literal bytes otherwise. Frame N decodes from the last keyframe <= N.
+    struct RecordingHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        FrameLayout layout;
+        uint32_t fields;
+        uint32_t keyframeEvery;
+    };
+
+    struct RecordingIndexEntry {
+        uint64_t offset;
+        uint32_t size;
+        uint32_t keyframe;
+    };
+
+    struct RecordingFooter {
+        uint64_t indexOffset;
+        uint64_t frameCount;
+        char magic[8];
+    };
+
+    static_assert(std::is_trivially_copyable_v<RecordingHeader> && sizeof(RecordingIndexEntry) == 16 &&
+                  sizeof(RecordingFooter) == 24);
+
+    namespace rle {
+
+        inline void putVarint(std::vector<char> &out, uint64_t value) {
+            while (value >= 0x80) {
+                out.push_back(char(uint8_t(value) | 0x80));
+                value >>= 7;
+            }
+            out.push_back(char(value));
+        }
+
+        inline uint64_t getVarint(const char *&pos, const char *end) {
+            uint64_t value = 0;
+            for (int shift = 0; pos != end && shift < 64; shift += 7) {
+                uint8_t byte = uint8_t(*pos++);
+                value |= uint64_t(byte & 0x7f) << shift;
+                if (!(byte & 0x80)) {
+                    return value;
+                }
+            }
+            throw std::runtime_error("Corrupt frame in recording");
+        }
+
+        // Runs shorter than this are cheaper as part of a literal
+        constexpr size_t minRun = 4;
+
+        inline void encode(const char *data, size_t size, std::vector<char> &out) {
+            size_t literalStart = 0;
+            size_t i = 0;
+            auto flushLiteral = [&](size_t to) {
+                if (to > literalStart) {
+                    putVarint(out, uint64_t(to - literalStart) << 1);
+                    out.insert(out.end(), data + literalStart, data + to);
+                }
+            };
+            while (i < size) {
+                size_t run = 1;
+                while (i + run < size && data[i + run] == data[i]) {
+                    ++run;
+                }
+                if (run >= minRun) {
+                    flushLiteral(i);
+                    putVarint(out, uint64_t(run) << 1 | 1);
+                    out.push_back(data[i]);
+                    i += run;
+                    literalStart = i;
+                } else {
+                    i += run;
+                }
+            }
+            flushLiteral(size);
+        }
+
+        // XORs the decoded bytes into dst, which holds the previous frame (or zeros)
+        inline void decodeXor(const char *pos, const char *end, char *dst, size_t size) {
+            size_t at = 0;
+            while (pos != end) {
+                uint64_t token = getVarint(pos, end);
+                size_t length = size_t(token >> 1);
+                if (length > size - at || (!(token & 1) && size_t(end - pos) < length) || ((token & 1) && pos == end)) {
+                    throw std::runtime_error("Corrupt frame in recording");
+                }
+                if (token & 1) {
+                    char value = *pos++;
+                    if (value != 0) {
+                        for (size_t i = 0; i < length; ++i) {
+                            dst[at + i] ^= value;
+                        }
+                    }
+                } else {
+                    for (size_t i = 0; i < length; ++i) {
+                        dst[at + i] ^= pos[i];
+                    }
+                    pos += length;
+                }
+                at += length;
+            }
+            if (at != size) {
+                throw std::runtime_error("Corrupt frame in recording");
+            }
+        }
+
+    }
+
+    // Appends one frame per step. Encoded frames collect in memory and go to the file a chunk
+    // (keyframe to keyframe) at a time; close() writes the index that makes the file seekable.
+    class FrameRecorder {
+    public:
+        FrameRecorder(const std::string &path, const FrameLayout &layout, uint32_t fields, uint32_t keyframeEvery)
+                : file_(path, std::ios::binary | std::ios::trunc) {
+            if (!file_.is_open()) {
+                throw std::runtime_error("Failed to open recording file: " + path);
+            }
+            if (fields == 0 || keyframeEvery == 0) {
+                throw std::invalid_argument("Recording needs at least one field and a positive keyframe interval");
+            }
+            header_ = RecordingHeader{};
+            std::memcpy(header_.magic, recordingMagic, sizeof(recordingMagic));
+            header_.version = recordingVersion;
+            header_.headerSize = sizeof(RecordingHeader);
+            header_.layout = layout;
+            header_.fields = fields;
+            header_.keyframeEvery = keyframeEvery;
+            file_.write(reinterpret_cast<const char *>(&header_), sizeof(header_));
+            offset_ = sizeof(header_);
+            previous_.assign(layout.frameBytes(fields), 0);
+        }
+
+        FrameRecorder(const FrameRecorder &) = delete;
+        FrameRecorder &operator=(const FrameRecorder &) = delete;
+
+        ~FrameRecorder() {
+            try {
+                close();
+            } catch (...) {
+            }
+        }
+
+        uint32_t fields() const {
+            return header_.fields;
+        }
+
+        void append(const std::vector<char> &raw) {
+            if (raw.size() != previous_.size()) {
+                throw std::invalid_argument("Frame size does not match the recording layout");
+            }
+            bool keyframe = index_.size() % header_.keyframeEvery == 0;
+            if (keyframe) {
+                flushChunk();
+                std::fill(previous_.begin(), previous_.end(), 0);
+            }
+            for (size_t i = 0; i < raw.size(); ++i) {
+                previous_[i] ^= raw[i];
+            }
+            size_t start = chunk_.size();
+            rle::encode(previous_.data(), previous_.size(), chunk_);
+            index_.push_back({offset_ + start, uint32_t(chunk_.size() - start), keyframe});
+            previous_ = raw;
+            rawBytes_ += raw.size();
+        }
+
+        void close() {
+            if (closed_) {
+                return;
+            }
+            closed_ = true;
+            flushChunk();
+            RecordingFooter footer{offset_, index_.size(), {}};
+            std::memcpy(footer.magic, recordingIndexMagic, sizeof(recordingIndexMagic));
+            file_.write(reinterpret_cast<const char *>(index_.data()), std::streamsize(index_.size() * sizeof(RecordingIndexEntry)));
+            file_.write(reinterpret_cast<const char *>(&footer), sizeof(footer));
+            file_.close();
+        }
+
+        size_t frameCount() const {
+            return index_.size();
+        }
+
+        uint64_t rawBytes() const {
+            return rawBytes_;
+        }
+
+        uint64_t encodedBytes() const {
+            return offset_ + chunk_.size() - sizeof(RecordingHeader);
+        }
+
+    private:
+        void flushChunk() {
+            file_.write(chunk_.data(), std::streamsize(chunk_.size()));
+            offset_ += chunk_.size();
+            chunk_.clear();
+        }
+
+        std::ofstream file_;
+        RecordingHeader header_{};
+        std::vector<char> previous_;
+        std::vector<char> chunk_;
+        std::vector<RecordingIndexEntry> index_;
+        uint64_t offset_ = 0;
+        uint64_t rawBytes_ = 0;
+        bool closed_ = false;
+    };
+
+    // Random access to the frames of a closed recording
+    class RecordingReader {
+    public:
+        explicit RecordingReader(const std::string &path) : file_(path) {
+            if (file_.size() < sizeof(RecordingHeader) + sizeof(RecordingFooter) ||
+                std::memcmp(file_.data(), recordingMagic, sizeof(recordingMagic)) != 0) {
+                throw std::runtime_error("Not a recording: " + path);
+            }
+            std::memcpy(&header_, file_.data(), sizeof(header_));
+            if (header_.version != recordingVersion || header_.headerSize != sizeof(RecordingHeader)) {
+                throw std::runtime_error("Unsupported recording version " + std::to_string(header_.version));
+            }
+            RecordingFooter footer{};
+            std::memcpy(&footer, file_.data() + file_.size() - sizeof(footer), sizeof(footer));
+            if (std::memcmp(footer.magic, recordingIndexMagic, sizeof(recordingIndexMagic)) != 0 ||
+                footer.indexOffset + footer.frameCount * sizeof(RecordingIndexEntry) + sizeof(footer) != file_.size()) {
+                throw std::runtime_error("Recording has no frame index, it was not closed: " + path);
+            }
+            index_.resize(footer.frameCount);
+            std::memcpy(index_.data(), file_.data() + footer.indexOffset, index_.size() * sizeof(RecordingIndexEntry));
+            for (const auto &entry : index_) {
+                if (entry.offset + entry.size > footer.indexOffset) {
+                    throw std::runtime_error("Corrupt frame index in recording: " + path);
+                }
+            }
+        }
+
+        const RecordingHeader &header() const {
+            return header_;
+        }
+
+        size_t frameCount() const {
+            return index_.size();
+        }
+
+        size_t encodedSize(size_t frame) const {
+            return index_.at(frame).size;
+        }
+
+        // Raw bytes of frame n, decoding only from the keyframe before it
+        void read(size_t n, std::vector<char> &raw) const {
+            if (n >= index_.size()) {
+                throw std::out_of_range("Recording has " + std::to_string(index_.size()) + " frames");
+            }
+            size_t from = n;
+            while (!index_[from].keyframe) {
+                if (from == 0) {
+                    throw std::runtime_error("Recording does not start with a keyframe");
+                }
+                --from;
+            }
+            raw.assign(header_.layout.frameBytes(header_.fields), 0);
+            for (size_t f = from; f <= n; ++f) {
+                const char *begin = file_.data() + index_[f].offset;
+                rle::decodeXor(begin, begin + index_[f].size, raw.data(), raw.size());
+            }
+        }
+
+    private:
+        MappedFile file_;
+        RecordingHeader header_{};
+        std::vector<RecordingIndexEntry> index_;
+    };
+
+    // Value of a raw pressure or velocity cell as a double, from the type code and size in the layout
+    inline double rawToDouble(int typeCode, uint32_t size, const char *bytes) {
+        if (typeCode == 1) {
+            float value;
+            std::memcpy(&value, bytes, sizeof(value));
+            return value;
+        }
+        if (typeCode == 2) {
+            double value;
+            std::memcpy(&value, bytes, sizeof(value));
+            return value;
+        }
+        int64_t raw = 0;
+        switch (size) {
+            case 1: { int8_t v; std::memcpy(&v, bytes, 1); raw = v; break; }
+            case 2: { int16_t v; std::memcpy(&v, bytes, 2); raw = v; break; }
+            case 4: { int32_t v; std::memcpy(&v, bytes, 4); raw = v; break; }
+            case 8: { int64_t v; std::memcpy(&v, bytes, 8); raw = v; break; }
+            default: throw std::runtime_error("Unsupported value size " + std::to_string(size));
+        }
+        int k = typeCode >= 10000000 ? typeCode % 10000000 : typeCode >= 100000 ? typeCode % 100000 : typeCode % 1000;
+        return double(raw) / double(uint64_t(1) << k);
+    }
+
+}
+
+#endif //FLUIDFINALVER_RECORDING_H
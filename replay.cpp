@@ -0,0 +1,83 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "types.hpp"
+
+// Reads recordings written with --record:
+//   fluid_replay --input=run.rec --info
+//   fluid_replay --input=run.rec --frame=N [--field=grid|pressure|velocity]
+// Frame N is decoded from the keyframe before it, the rest of the file is never touched.
+
+void PrintInfo(const FluidPhysics::RecordingReader& reader, std::ostream& out) {
+    const auto& header = reader.header();
+    const auto& layout = header.layout;
+    size_t encoded = 0;
+    for (size_t i = 0; i < reader.frameCount(); ++i) {
+        encoded += reader.encodedSize(i);
+    }
+    const double raw = double(layout.frameBytes(header.fields)) * reader.frameCount();
+    out << "size: " << layout.width << "x" << layout.height << "\n"
+        << "p-type: " << GetTypeName(layout.pTypeCode) << ", v-type: " << GetTypeName(layout.vTypeCode) << "\n"
+        << "fields:" << ((header.fields & FluidPhysics::RecordGrid) ? " grid" : "")
+        << ((header.fields & FluidPhysics::RecordPressure) ? " pressure" : "")
+        << ((header.fields & FluidPhysics::RecordVelocity) ? " velocity" : "") << "\n"
+        << "frames: " << reader.frameCount() << ", keyframe every " << header.keyframeEvery << "\n"
+        << "encoded: " << encoded / 1024 << " KiB of " << size_t(raw) / 1024 << " KiB raw ("
+        << (encoded > 0 ? raw / double(encoded) : 0.0) << "x)\n";
+}
+
+void PrintFrame(const FluidPhysics::RecordingReader& reader, const std::vector<char>& raw, FluidPhysics::RecordField field,
+                std::ostream& out) {
+    const auto& header = reader.header();
+    const auto& layout = header.layout;
+    if (!(header.fields & field)) {
+        throw std::invalid_argument("Field is not in the recording");
+    }
+    const char* src = raw.data() + layout.fieldOffset(header.fields, field);
+    for (int i = 0; i < layout.width; ++i) {
+        if (field == FluidPhysics::RecordGrid) {
+            out.write(src, layout.height);
+            src += layout.height;
+        } else {
+            const bool pressure = field == FluidPhysics::RecordPressure;
+            const int typeCode = pressure ? layout.pTypeCode : layout.vTypeCode;
+            const uint32_t size = pressure ? layout.pSize : layout.vSize;
+            const int values = pressure ? layout.height : layout.height * 4;
+            for (int j = 0; j < values; ++j) {
+                out << (j ? " " : "") << FluidPhysics::rawToDouble(typeCode, size, src);
+                src += size;
+            }
+        }
+        out << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    OptionsParser optsParser(argc, argv);
+    const FluidPhysics::RecordingReader reader(optsParser.getOptVal("--input"));
+
+    if (optsParser.hasOpt("--info") || !optsParser.hasOpt("--frame")) {
+        PrintInfo(reader, std::cout);
+        return 0;
+    }
+
+    const int frameNo = optsParser.getOptValAsInt("--frame");
+    if (frameNo < 0) {
+        throw std::invalid_argument("Frame number must not be negative");
+    }
+    const uint32_t field = optsParser.hasOpt("--field") ? GetRecordFields(optsParser.getOptVal("--field")) : FluidPhysics::RecordGrid;
+    if (field != FluidPhysics::RecordGrid && field != FluidPhysics::RecordPressure && field != FluidPhysics::RecordVelocity) {
+        throw std::invalid_argument("--field takes a single field");
+    }
+
+    const auto startTime = std::chrono::steady_clock::now();
+    std::vector<char> raw;
+    reader.read(size_t(frameNo), raw);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+    PrintFrame(reader, raw, FluidPhysics::RecordField(field), std::cout);
+    std::cerr << "frame " << frameNo << " decoded in " << elapsed.count() * 1e3 << " ms" << std::endl;
+    return 0;
+}
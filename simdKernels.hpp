@@ -0,0 +1,296 @@
+#ifndef FLUIDFINALVER_SIMDKERNELS_H
+#define FLUIDFINALVER_SIMDKERNELS_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#include "Fixed.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FLUID_AVX2_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace FluidPhysics {
+
+    enum class KernelPath {
+        Auto,   // AVX2 when the CPU has it, scalar otherwise
+        Scalar, // reference loops, kept for validation
+        Avx2,
+    };
+
+    inline bool cpuHasAvx2() {
+#ifdef FLUID_AVX2_KERNELS
+        static const bool has = __builtin_cpu_supports("avx2");
+        return has;
+#else
+        return false;
+#endif
+    }
+
+    inline KernelPath resolveKernelPath(KernelPath path) {
+        if (path == KernelPath::Auto) {
+            return cpuHasAvx2() ? KernelPath::Avx2 : KernelPath::Scalar;
+        }
+        if (path == KernelPath::Avx2 && !cpuHasAvx2()) {
+            throw std::invalid_argument("AVX2 kernels are not supported on this CPU");
+        }
+        return path;
+    }
+
+    // How a value is laid out in a vector lane. Fixed compares and adds as its raw integer,
+    // so the vector kernels give exactly what the scalar operators give.
+    enum class LaneKind {
+        None,
+        F32,
+        F64,
+        I32,
+        I64,
+    };
+
+    template<typename T>
+    struct LaneOf {
+        static constexpr LaneKind kind = LaneKind::None;
+        static constexpr bool wrappingAdd = false;
+    };
+
+    template<>
+    struct LaneOf<float> {
+        static constexpr LaneKind kind = LaneKind::F32;
+        static constexpr bool wrappingAdd = true;
+    };
+
+    template<>
+    struct LaneOf<double> {
+        static constexpr LaneKind kind = LaneKind::F64;
+        static constexpr bool wrappingAdd = true;
+    };
+
+    template<int N, int K, bool fast, FixedOverflow overflow>
+    struct LaneOf<Fixed<N, K, fast, overflow>> {
+        using raw = typename Fixed<N, K, fast, overflow>::value_t;
+        static_assert(sizeof(Fixed<N, K, fast, overflow>) == sizeof(raw));
+        static constexpr LaneKind kind = sizeof(raw) == 4 ? LaneKind::I32 : sizeof(raw) == 8 ? LaneKind::I64 : LaneKind::None;
+        // raw integer addition only matches operator+ when it is allowed to wrap
+        static constexpr bool wrappingAdd = overflow == FixedOverflow::Wrap;
+    };
+
+    // Bit d of out[y] is set when cell y of the row and its neighbour in direction d are both
+    // open and the neighbour's previous pressure is lower. Neighbours of wall cells are never
+    // read, so the border rows and columns need no special casing as long as they are walls.
+    template<typename T>
+    void pressureMaskRowScalar(const char *gridUp, const char *grid, const char *gridDown,
+                               const T *pUp, const T *p, const T *pDown, int y0, int y1, uint8_t *out) {
+        for (int y = y0; y < y1; ++y) {
+            if (grid[y] == '#') {
+                out[y] = 0;
+                continue;
+            }
+            out[y] = uint8_t((gridUp[y] != '#' && pUp[y] < p[y]) |
+                             (gridDown[y] != '#' && pDown[y] < p[y]) << 1 |
+                             (grid[y - 1] != '#' && p[y - 1] < p[y]) << 2 |
+                             (grid[y + 1] != '#' && p[y + 1] < p[y]) << 3);
+        }
+    }
+
+    // Calls apply(y) for every y in [y0, y1) whose cell and the cell below are open
+    template<typename F>
+    void gravityRowScalar(const char *grid, const char *gridDown, int y0, int y1, F &&apply) {
+        for (int y = y0; y < y1; ++y) {
+            if (grid[y] != '#' && gridDown[y] != '#') {
+                apply(y);
+            }
+        }
+    }
+
+#ifdef FLUID_AVX2_KERNELS
+    namespace avx2 {
+
+        template<LaneKind L>
+        struct Lanes;
+
+        template<>
+        struct Lanes<LaneKind::F32> {
+            static constexpr int count = 8;
+
+            __attribute__((target("avx2"))) static __m256i lt(const void *a, const void *b) {
+                return _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(static_cast<const float *>(a)),
+                                                         _mm256_loadu_ps(static_cast<const float *>(b)), _CMP_LT_OQ));
+            }
+
+            __attribute__((target("avx2"))) static __m256i wallMask(const char *g) {
+                __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(g));
+                return _mm256_cvtepi8_epi32(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('#')));
+            }
+
+            __attribute__((target("avx2"))) static void storeBytes(uint8_t *out, __m256i v) {
+                __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(words, words));
+            }
+
+            __attribute__((target("avx2"))) static void add(void *dst, const void *g, __m256i blocked) {
+                auto *d = static_cast<float *>(dst);
+                __m256 v = _mm256_loadu_ps(d);
+                __m256 sum = _mm256_add_ps(v, _mm256_set1_ps(*static_cast<const float *>(g)));
+                _mm256_storeu_ps(d, _mm256_blendv_ps(sum, v, _mm256_castsi256_ps(blocked)));
+            }
+        };
+
+        template<>
+        struct Lanes<LaneKind::I32> : Lanes<LaneKind::F32> {
+            __attribute__((target("avx2"))) static __m256i lt(const void *a, const void *b) {
+                return _mm256_cmpgt_epi32(_mm256_loadu_si256(static_cast<const __m256i *>(b)),
+                                          _mm256_loadu_si256(static_cast<const __m256i *>(a)));
+            }
+
+            __attribute__((target("avx2"))) static void add(void *dst, const void *g, __m256i blocked) {
+                auto *d = static_cast<__m256i *>(dst);
+                int32_t raw;
+                std::memcpy(&raw, g, sizeof(raw));
+                __m256i inc = _mm256_andnot_si256(blocked, _mm256_set1_epi32(raw));
+                _mm256_storeu_si256(d, _mm256_add_epi32(_mm256_loadu_si256(d), inc));
+            }
+        };
+
+        template<>
+        struct Lanes<LaneKind::F64> {
+            static constexpr int count = 4;
+
+            __attribute__((target("avx2"))) static __m256i lt(const void *a, const void *b) {
+                return _mm256_castpd_si256(_mm256_cmp_pd(_mm256_loadu_pd(static_cast<const double *>(a)),
+                                                         _mm256_loadu_pd(static_cast<const double *>(b)), _CMP_LT_OQ));
+            }
+
+            __attribute__((target("avx2"))) static __m256i wallMask(const char *g) {
+                int32_t raw;
+                std::memcpy(&raw, g, sizeof(raw));
+                return _mm256_cvtepi8_epi64(_mm_cmpeq_epi8(_mm_cvtsi32_si128(raw), _mm_set1_epi8('#')));
+            }
+
+            __attribute__((target("avx2"))) static void storeBytes(uint8_t *out, __m256i v) {
+                // the low dword of each 64-bit lane holds the whole value
+                __m256i dwords = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6));
+                __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(dwords), _mm256_castsi256_si128(dwords));
+                int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+                std::memcpy(out, &packed, sizeof(packed));
+            }
+
+            __attribute__((target("avx2"))) static void add(void *dst, const void *g, __m256i blocked) {
+                auto *d = static_cast<double *>(dst);
+                __m256d v = _mm256_loadu_pd(d);
+                __m256d sum = _mm256_add_pd(v, _mm256_set1_pd(*static_cast<const double *>(g)));
+                _mm256_storeu_pd(d, _mm256_blendv_pd(sum, v, _mm256_castsi256_pd(blocked)));
+            }
+        };
+
+        template<>
+        struct Lanes<LaneKind::I64> : Lanes<LaneKind::F64> {
+            __attribute__((target("avx2"))) static __m256i lt(const void *a, const void *b) {
+                return _mm256_cmpgt_epi64(_mm256_loadu_si256(static_cast<const __m256i *>(b)),
+                                          _mm256_loadu_si256(static_cast<const __m256i *>(a)));
+            }
+
+            __attribute__((target("avx2"))) static void add(void *dst, const void *g, __m256i blocked) {
+                auto *d = static_cast<__m256i *>(dst);
+                int64_t raw;
+                std::memcpy(&raw, g, sizeof(raw));
+                __m256i inc = _mm256_andnot_si256(blocked, _mm256_set1_epi64x(raw));
+                _mm256_storeu_si256(d, _mm256_add_epi64(_mm256_loadu_si256(d), inc));
+            }
+        };
+
+        // Vector part of pressureMaskRowScalar; returns the first y it did not cover.
+        // Lanes read y - 1 .. y + count, so it starts at 1 and stops before the last column.
+        template<typename T>
+        __attribute__((target("avx2"))) int pressureMaskRow(const char *gridUp, const char *grid, const char *gridDown,
+                                                            const T *pUp, const T *p, const T *pDown,
+                                                            int y0, int y1, int height, uint8_t *out) {
+            using L = Lanes<LaneOf<T>::kind>;
+            int y = y0;
+            for (; y + L::count <= y1 && y + L::count < height; y += L::count) {
+                __m256i open = _mm256_andnot_si256(L::wallMask(grid + y), _mm256_set1_epi32(-1));
+                __m256i up = _mm256_andnot_si256(L::wallMask(gridUp + y), L::lt(pUp + y, p + y));
+                __m256i down = _mm256_andnot_si256(L::wallMask(gridDown + y), L::lt(pDown + y, p + y));
+                __m256i left = _mm256_andnot_si256(L::wallMask(grid + y - 1), L::lt(p + y - 1, p + y));
+                __m256i right = _mm256_andnot_si256(L::wallMask(grid + y + 1), L::lt(p + y + 1, p + y));
+                __m256i bits = _mm256_or_si256(
+                        _mm256_or_si256(_mm256_and_si256(up, _mm256_set1_epi32(1)), _mm256_and_si256(down, _mm256_set1_epi32(2))),
+                        _mm256_or_si256(_mm256_and_si256(left, _mm256_set1_epi32(4)), _mm256_and_si256(right, _mm256_set1_epi32(8))));
+                L::storeBytes(out + y, _mm256_and_si256(open, bits));
+            }
+            return y;
+        }
+
+        // Adds g to dst[y] for 32 cells at a time whose cell and the cell below are open,
+        // as a masked vector add when dst is contiguous and per set bit otherwise
+        template<typename T, typename F>
+        __attribute__((target("avx2"))) int gravityRow(const char *grid, const char *gridDown, T *dst, ptrdiff_t stride,
+                                                       T g, int y0, int y1, F &&apply) {
+            constexpr LaneKind kind = LaneOf<T>::kind;
+            int y = y0;
+            if constexpr (kind != LaneKind::None && LaneOf<T>::wrappingAdd) {
+                if (stride == 1) {
+                    using L = Lanes<kind>;
+                    for (; y + L::count <= y1; y += L::count) {
+                        __m256i blocked = _mm256_or_si256(L::wallMask(grid + y), L::wallMask(gridDown + y));
+                        L::add(dst + y, &g, blocked);
+                    }
+                    return y;
+                }
+            }
+            const __m256i wall = _mm256_set1_epi8('#');
+            for (; y + 32 <= y1; y += 32) {
+                __m256i blocked = _mm256_or_si256(
+                        _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(grid + y)), wall),
+                        _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(gridDown + y)), wall));
+                for (uint32_t bits = ~uint32_t(_mm256_movemask_epi8(blocked)); bits != 0; bits &= bits - 1) {
+                    apply(y + std::countr_zero(bits));
+                }
+            }
+            return y;
+        }
+
+    }
+#endif
+
+    // Fills the direction masks of pressureMaskRowScalar for cells [y0, y1) of a row of the given height
+    template<typename T>
+    void pressureMaskRow(KernelPath path, const char *gridUp, const char *grid, const char *gridDown,
+                         const T *pUp, const T *p, const T *pDown, int y0, int y1, int height, uint8_t *out) {
+        int y = y0;
+#ifdef FLUID_AVX2_KERNELS
+        if constexpr (LaneOf<T>::kind != LaneKind::None) {
+            if (path == KernelPath::Avx2 && y1 > 1) {
+                if (y == 0) {
+                    pressureMaskRowScalar(gridUp, grid, gridDown, pUp, p, pDown, 0, 1, out);
+                    y = 1;
+                }
+                y = avx2::pressureMaskRow(gridUp, grid, gridDown, pUp, p, pDown, y, y1, height, out);
+            }
+        }
+#endif
+        pressureMaskRowScalar(gridUp, grid, gridDown, pUp, p, pDown, y, y1, out);
+    }
+
+    // Adds g to dst[y * stride] for every cell in [y0, y1) of the row that has an open cell below it
+    template<typename T>
+    void gravityRow(KernelPath path, const char *grid, const char *gridDown, T *dst, ptrdiff_t stride, T g, int y0, int y1) {
+        auto apply = [&](int y) {
+            dst[y * stride] += g;
+        };
+        int y = y0;
+#ifdef FLUID_AVX2_KERNELS
+        if (path == KernelPath::Avx2) {
+            y = avx2::gravityRow(grid, gridDown, dst, stride, g, y0, y1, apply);
+        }
+#endif
+        gravityRowScalar(grid, gridDown, y, y1, apply);
+    }
+
+}
+
+#endif //FLUIDFINALVER_SIMDKERNELS_H
@@ -0,0 +1,165 @@
+#ifndef FLUIDFINALVER_SNAPSHOTWRITER_H
+#define FLUIDFINALVER_SNAPSHOTWRITER_H
+
+#include <array>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "originalFunctions.hpp"
+#include "checkpoint.hpp"
+
+namespace FluidPhysics {
+
+    // Takes snapshots at step boundaries without stalling the simulation: capture() only copies
+    // the engine state into one of two staging engines, and a background thread serialises it
+    // to <basePath>.<number>, fsyncs it and removes the file that fell out of the last `keep`.
+    class SnapshotWriter {
+    public:
+        SnapshotWriter(std::string basePath, CheckpointFormat format, int keep)
+                : basePath_(std::move(basePath)), format_(format), keep_(keep) {
+            if (keep_ <= 0) {
+                throw std::invalid_argument("Snapshot count to keep must be positive");
+            }
+            worker_ = std::thread([this] { run(); });
+        }
+
+        SnapshotWriter(const SnapshotWriter&) = delete;
+        SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+        ~SnapshotWriter() {
+            {
+                std::lock_guard lock(mutex_);
+                stop_ = true;
+            }
+            changed_.notify_all();
+            worker_.join();
+        }
+
+        // Blocks only if both staging buffers are still waiting to be written
+        void capture(const IEngine& engine) {
+            std::unique_lock lock(mutex_);
+            changed_.wait(lock, [this] { return !slots_[0].pending || !slots_[1].pending; });
+            Slot& slot = !slots_[0].pending ? slots_[0] : slots_[1];
+            lock.unlock();
+            engine.copyStateTo(slot.engine);
+            lock.lock();
+            slot.number = nextNumber_++;
+            slot.pending = true;
+            lock.unlock();
+            changed_.notify_all();
+        }
+
+        void flush() {
+            std::unique_lock lock(mutex_);
+            changed_.wait(lock, [this] { return !slots_[0].pending && !slots_[1].pending; });
+        }
+
+    private:
+        struct Slot {
+            std::unique_ptr<IEngine> engine;
+            long long number = 0;
+            bool pending = false;
+        };
+
+        std::string fileName(long long number) const {
+            return basePath_ + "." + std::to_string(number);
+        }
+
+        void run() {
+            std::ostringstream buffer;
+            while (true) {
+                Slot* slot = nullptr;
+                {
+                    std::unique_lock lock(mutex_);
+                    changed_.wait(lock, [this] { return stop_ || slots_[0].pending || slots_[1].pending; });
+                    if (slots_[0].pending && (!slots_[1].pending || slots_[0].number < slots_[1].number)) {
+                        slot = &slots_[0];
+                    } else if (slots_[1].pending) {
+                        slot = &slots_[1];
+                    } else {
+                        return;
+                    }
+                }
+                try {
+                    buffer.str({});
+                    if (format_ == CheckpointFormat::Text) {
+                        slot->engine->save(buffer);
+                    } else {
+                        slot->engine->saveBinary(buffer);
+                    }
+                    writeDurably(fileName(slot->number), buffer.view());
+                    if (slot->number >= keep_) {
+                        std::error_code ec;
+                        std::filesystem::remove(fileName(slot->number - keep_), ec);
+                    }
+                    std::cerr << "Saved in file " << fileName(slot->number) << std::endl;
+                } catch (const std::exception& ex) {
+                    std::cerr << "Snapshot " << slot->number << " failed: " << ex.what() << std::endl;
+                }
+                {
+                    std::lock_guard lock(mutex_);
+                    slot->pending = false;
+                }
+                changed_.notify_all();
+            }
+        }
+
+        // Writes to a temporary file, fsyncs it and renames it into place
+        static void writeDurably(const std::string& path, std::string_view data) {
+            const std::string tmpPath = path + ".tmp";
+#ifdef _WIN32
+            {
+                std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+                if (!file.write(data.data(), std::streamsize(data.size()))) {
+                    throw std::runtime_error("Failed to write " + tmpPath);
+                }
+            }
+#else
+            int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                throw std::runtime_error("Failed to open " + tmpPath);
+            }
+            size_t written = 0;
+            while (written < data.size()) {
+                ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+                if (n < 0) {
+                    ::close(fd);
+                    throw std::runtime_error("Failed to write " + tmpPath);
+                }
+                written += size_t(n);
+            }
+            if (::fsync(fd) != 0) {
+                ::close(fd);
+                throw std::runtime_error("Failed to sync " + tmpPath);
+            }
+            ::close(fd);
+#endif
+            std::filesystem::rename(tmpPath, path);
+        }
+
+        std::string basePath_;
+        CheckpointFormat format_;
+        int keep_;
+        std::array<Slot, 2> slots_;
+        long long nextNumber_ = 0;
+        std::mutex mutex_;
+        std::condition_variable changed_;
+        bool stop_ = false;
+        std::thread worker_;
+    };
+
+}
+
+#endif //FLUIDFINALVER_SNAPSHOTWRITER_H
@@ -5,15 +5,54 @@
 #include <array>
 #include <algorithm>
 #include <cstring>
+#include <cstddef>
+#include <exception>
+#include <new>
 #include <stdexcept>
 
 namespace FluidPhysics {
 
+    constexpr size_t cacheLineSize = 64;
+
+    template<typename T, size_t Alignment = cacheLineSize>
+    struct AlignedAllocator {
+        using value_type = T;
+
+        template<typename U>
+        struct rebind {
+            using other = AlignedAllocator<U, Alignment>;
+        };
+
+        AlignedAllocator() = default;
+
+        template<typename U>
+        constexpr AlignedAllocator(const AlignedAllocator<U, Alignment> &) noexcept {}
+
+        T* allocate(size_t n) {
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+        }
+
+        void deallocate(T* p, size_t) noexcept {
+            ::operator delete(p, std::align_val_t(Alignment));
+        }
+
+        template<typename U>
+        bool operator==(const AlignedAllocator<U, Alignment> &) const noexcept { return true; }
+    };
+
+    // Rows are padded so that every row starts on a cache line when T packs evenly into one
+    template<typename T>
+    constexpr int rowStride(int height) {
+        constexpr int perLine = cacheLineSize % sizeof(T) == 0 ? int(cacheLineSize / sizeof(T)) : 1;
+        return (height + perLine - 1) / perLine * perLine;
+    }
+
     template<typename T, int Width, int Height>
     struct Array {
-        std::array<std::array<T, Height>, Width> arr{};
+        alignas(cacheLineSize) std::array<std::array<T, Height>, Width> arr{};
         static constexpr int gridWidth = Width;
         static constexpr int gridHeight = Height;
+        static constexpr int stride = Height;
 
         Array() = default;
 
@@ -22,28 +61,43 @@ namespace FluidPhysics {
         }
 
         T* operator[](int n) noexcept {
+#ifndef NDEBUG
             if (n < 0 || n >= gridWidth) {
-                throw std::out_of_range("Index out of range");
+                std::terminate();
             }
+#endif
             return arr[n].data();
         }
 
         const T* operator[](int n) const noexcept {
+#ifndef NDEBUG
             if (n < 0 || n >= gridWidth) {
-                throw std::out_of_range("Index out of range");
+                std::terminate();
             }
+#endif
             return arr[n].data();
         }
 
+        T* data() noexcept { return arr[0].data(); }
+        const T* data() const noexcept { return arr[0].data(); }
+        static constexpr size_t size() noexcept { return size_t(Width) * Height; }
+        // Storage outside the object itself; a static Array lives entirely inside it
+        static constexpr size_t heapBytes() noexcept { return 0; }
+
+        void fill(const T& value) {
+            std::fill_n(data(), size(), value);
+        }
+
         Array& operator=(const Array& other) = default;
 
     };
 
     template<typename T>
     struct Array<T, -1, -1> {
-        std::vector<std::vector<T>> arr{};
+        std::vector<T, AlignedAllocator<T>> arr{};
         int gridWidth = 0;
         int gridHeight = 0;
+        int stride = 0;
 
         Array() = default;
 
@@ -53,21 +107,35 @@ namespace FluidPhysics {
             }
             gridWidth = n;
             gridHeight = m;
-            arr.assign(gridWidth, std::vector<T>(gridHeight, T{}));
+            stride = rowStride<T>(m);
+            arr.assign(size_t(gridWidth) * stride, T{});
         }
 
-        std::vector<T>& operator[](int n) {
+        T* operator[](int n) {
+#ifndef NDEBUG
             if (n < 0 || n >= gridWidth) {
                 throw std::out_of_range("Index out of range");
             }
-            return arr[n];
+#endif
+            return arr.data() + size_t(n) * stride;
         }
 
-        const std::vector<T>& operator[](int n) const {
+        const T* operator[](int n) const {
+#ifndef NDEBUG
             if (n < 0 || n >= gridWidth) {
                 throw std::out_of_range("Index out of range");
             }
-            return arr[n];
+#endif
+            return arr.data() + size_t(n) * stride;
+        }
+
+        T* data() noexcept { return arr.data(); }
+        const T* data() const noexcept { return arr.data(); }
+        size_t size() const noexcept { return arr.size(); }
+        size_t heapBytes() const noexcept { return arr.capacity() * sizeof(T); }
+
+        void fill(const T& value) {
+            std::fill(arr.begin(), arr.end(), value);
         }
 
         Array& operator=(const Array& other) = default;
@@ -0,0 +1,108 @@
+#ifndef FLUIDFINALVER_THREADPOOL_H
+#define FLUIDFINALVER_THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <stdexcept>
+
+namespace FluidPhysics {
+
+    // Fixed set of workers that split an index range into one contiguous chunk per thread.
+    // The calling thread runs chunk 0, so a pool of size N spawns N - 1 threads.
+    class ThreadPool {
+    public:
+        explicit ThreadPool(int threads) {
+            if (threads <= 0) {
+                throw std::invalid_argument("Thread count must be positive");
+            }
+            for (int i = 1; i < threads; ++i) {
+                workers_.emplace_back([this, i] { workerLoop(i); });
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        ~ThreadPool() {
+            {
+                std::lock_guard lock(mutex_);
+                stop_ = true;
+            }
+            wake_.notify_all();
+            for (auto &worker : workers_) {
+                worker.join();
+            }
+        }
+
+        int size() const {
+            return int(workers_.size()) + 1;
+        }
+
+        // Calls body(from, to, chunk) for every chunk of [begin, end) and waits for all of them
+        template<typename F>
+        void parallelFor(int begin, int end, F &&body) {
+            int chunks = size();
+            auto runChunk = [&](int chunk) {
+                long long len = end - begin;
+                int from = begin + int(len * chunk / chunks);
+                int to = begin + int(len * (chunk + 1) / chunks);
+                if (from < to) {
+                    body(from, to, chunk);
+                }
+            };
+            if (chunks == 1) {
+                runChunk(0);
+                return;
+            }
+            {
+                std::lock_guard lock(mutex_);
+                task_ = runChunk;
+                pending_ = chunks - 1;
+                ++generation_;
+            }
+            wake_.notify_all();
+            runChunk(0);
+            std::unique_lock lock(mutex_);
+            done_.wait(lock, [this] { return pending_ == 0; });
+            task_ = nullptr;
+        }
+
+    private:
+        void workerLoop(int chunk) {
+            int seen = 0;
+            while (true) {
+                std::function<void(int)> task;
+                {
+                    std::unique_lock lock(mutex_);
+                    wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+                    if (stop_) {
+                        return;
+                    }
+                    seen = generation_;
+                    task = task_;
+                }
+                task(chunk);
+                {
+                    std::lock_guard lock(mutex_);
+                    --pending_;
+                }
+                done_.notify_one();
+            }
+        }
+
+        std::vector<std::thread> workers_;
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::condition_variable done_;
+        std::function<void(int)> task_;
+        int generation_ = 0;
+        int pending_ = 0;
+        bool stop_ = false;
+    };
+
+}
+
+#endif //FLUIDFINALVER_THREADPOOL_H
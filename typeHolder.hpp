@@ -18,6 +18,8 @@ namespace FluidPhysics {
             return float{};
         } else if constexpr (n == 2) {
             return double{};
+        } else if constexpr (n > 10000000) {
+            return Fixed<n / 10000000, n % 10000000, false, FixedOverflow::Saturate>{};
         } else if constexpr (n > 100000) {
             return Fixed<n / 100000, n % 100000, true>{};
         } else if constexpr (n > 1000) {
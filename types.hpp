@@ -10,6 +10,7 @@
 #define DOUBLE 2
 #define FIXED(n, k) ((n) * 1000 + (k))
 #define FAST_FIXED(n, k) ((n) * 100000 + (k))
+#define SAT_FIXED(n, k) ((n) * 10000000 + (k))
 #define S(n, m) std::pair<int, int>((n), (m))
 
 #ifndef DTYPES
@@ -34,7 +35,12 @@ public:
             std::string_view line(argv[i]);
             auto eqPos = line.find('=');
             if (eqPos == std::string_view::npos) {
-                throw std::invalid_argument("Invalid option '" + std::string(line) + "'");
+                // Bare "--name" switches are stored as "--name=true"
+                if (line.substr(0, 2) != "--" || line.size() == 2) {
+                    throw std::invalid_argument("Invalid option '" + std::string(line) + "'");
+                }
+                opts_.emplace(std::string(line), "true");
+                continue;
             }
             auto key = line.substr(0, eqPos);
             auto val = line.substr(eqPos + 1);
@@ -42,6 +48,10 @@ public:
         }
     }
 
+    bool hasOpt(const std::string& opt) const {
+        return opts_.contains(opt);
+    }
+
     std::string getOptVal(const std::string& opt) const {
         auto it = opts_.find(opt);
         if (it == opts_.end()) {
@@ -60,6 +70,16 @@ public:
         return result;
     }
 
+    double getOptValAsDouble(const std::string& opt) const {
+        std::string val = getOptVal(opt);
+        double result = 0;
+        auto [ptr, ec] = std::from_chars(val.data(), val.data() + val.size(), result);
+        if (ec != std::errc() || ptr != val.data() + val.size()) {
+            throw std::invalid_argument("Option '" + opt + "' value is not a valid number");
+        }
+        return result;
+    }
+
     std::pair<int, int> getOptValAsPair(const std::string& opt) const {
         std::string val = getOptVal(opt);
         size_t commaPos = val.find(',');
@@ -102,6 +122,24 @@ inline int GetTypeCode(std::string_view typeName) {
         return FIXED(n, k);
     }
 
+    if (typeName.substr(0, 10) == "SAT_FIXED(" && typeName.back() == ')') {
+        int n = 0, k = 0;
+        auto inner = typeName.substr(10, typeName.size() - 11);
+        size_t commaPos = inner.find(',');
+        if (commaPos == std::string::npos) {
+            throw std::invalid_argument("Invalid SAT_FIXED type format: " + std::string(typeName));
+        }
+        auto [ptr1, ec1] = std::from_chars(inner.data(), inner.data() + commaPos, n);
+        if (ec1 != std::errc()) {
+            throw std::invalid_argument("Invalid number in SAT_FIXED type: " + std::string(typeName));
+        }
+        auto [ptr2, ec2] = std::from_chars(inner.data() + commaPos + 1, inner.data() + inner.size(), k);
+        if (ec2 != std::errc()) {
+            throw std::invalid_argument("Invalid number in SAT_FIXED type: " + std::string(typeName));
+        }
+        return SAT_FIXED(n, k);
+    }
+
     if (typeName.substr(0, 11) == "FAST_FIXED(" && typeName.back() == ')') {
         int n = 0, k = 0;
         auto inner = typeName.substr(11, typeName.size() - 12);
@@ -130,4 +168,108 @@ inline int GetTypeCode(std::string_view typeName) {
     throw std::invalid_argument("Unknown type '" + std::string(typeName) + "'");
 }
 
+// Inverse of GetTypeCode, in the same spelling as --p-type and friends accept
+inline std::string GetTypeName(int typeCode) {
+    if (typeCode == FLOAT) {
+        return "FLOAT";
+    }
+    if (typeCode == DOUBLE) {
+        return "DOUBLE";
+    }
+    if (typeCode >= SAT_FIXED(1, 0)) {
+        return "SAT_FIXED(" + std::to_string(typeCode / 10000000) + "," + std::to_string(typeCode % 10000000) + ")";
+    }
+    if (typeCode >= FAST_FIXED(1, 0)) {
+        return "FAST_FIXED(" + std::to_string(typeCode / 100000) + "," + std::to_string(typeCode % 100000) + ")";
+    }
+    return "FIXED(" + std::to_string(typeCode / 1000) + "," + std::to_string(typeCode % 1000) + ")";
+}
+
+inline FluidPhysics::FlowSolverKind GetFlowSolverKind(std::string_view name) {
+    if (name == "dfs") {
+        return FluidPhysics::FlowSolverKind::Dfs;
+    }
+    if (name == "blocking") {
+        return FluidPhysics::FlowSolverKind::Blocking;
+    }
+    throw std::invalid_argument("Unknown flow solver '" + std::string(name) + "'");
+}
+
+inline FluidPhysics::RngKind GetRngKind(std::string_view name) {
+    if (name == "mt19937") {
+        return FluidPhysics::RngKind::Mt19937;
+    }
+    if (name == "philox") {
+        return FluidPhysics::RngKind::Philox;
+    }
+    throw std::invalid_argument("Unknown random generator '" + std::string(name) + "'");
+}
+
+inline FluidPhysics::KernelPath GetKernelPath(std::string_view name) {
+    if (name == "auto") {
+        return FluidPhysics::KernelPath::Auto;
+    }
+    if (name == "scalar") {
+        return FluidPhysics::KernelPath::Scalar;
+    }
+    if (name == "avx2") {
+        return FluidPhysics::KernelPath::Avx2;
+    }
+    throw std::invalid_argument("Unknown kernel path '" + std::string(name) + "'");
+}
+
+inline FluidPhysics::CheckpointFormat GetCheckpointFormat(std::string_view name) {
+    if (name == "text") {
+        return FluidPhysics::CheckpointFormat::Text;
+    }
+    if (name == "binary") {
+        return FluidPhysics::CheckpointFormat::Binary;
+    }
+    throw std::invalid_argument("Unknown checkpoint format '" + std::string(name) + "'");
+}
+
+inline std::pair<FluidPhysics::FrameMode, int> GetFrameMode(std::string_view name) {
+    if (name == "full") {
+        return {FluidPhysics::FrameMode::Full, 1};
+    }
+    if (name == "delta") {
+        return {FluidPhysics::FrameMode::Delta, 1};
+    }
+    if (name == "none") {
+        return {FluidPhysics::FrameMode::None, 1};
+    }
+    if (name.substr(0, 6) == "every:") {
+        int every = 0;
+        auto [ptr, ec] = std::from_chars(name.data() + 6, name.data() + name.size(), every);
+        if (ec != std::errc() || ptr != name.data() + name.size() || every <= 0) {
+            throw std::invalid_argument("Invalid frame interval in '" + std::string(name) + "'");
+        }
+        return {FluidPhysics::FrameMode::EveryNth, every};
+    }
+    throw std::invalid_argument("Unknown frame mode '" + std::string(name) + "'");
+}
+
+// Comma-separated list of grid, pressure and velocity as a RecordField mask
+inline uint32_t GetRecordFields(std::string_view names) {
+    uint32_t fields = 0;
+    while (!names.empty()) {
+        auto comma = names.find(',');
+        auto name = names.substr(0, comma);
+        if (name == "grid") {
+            fields |= FluidPhysics::RecordGrid;
+        } else if (name == "pressure") {
+            fields |= FluidPhysics::RecordPressure;
+        } else if (name == "velocity") {
+            fields |= FluidPhysics::RecordVelocity;
+        } else {
+            throw std::invalid_argument("Unknown record field '" + std::string(name) + "'");
+        }
+        names = comma == std::string_view::npos ? std::string_view() : names.substr(comma + 1);
+    }
+    if (fields == 0) {
+        throw std::invalid_argument("No record fields given");
+    }
+    return fields;
+}
+
 #endif //FLUIDFINALVER_TYPES_H
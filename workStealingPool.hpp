@@ -0,0 +1,141 @@
+#ifndef FLUIDFINALVER_WORKSTEALINGPOOL_H
+#define FLUIDFINALVER_WORKSTEALINGPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace FluidPhysics {
+
+    // Independent tasks of uneven length on a fixed set of workers. Every worker has its own
+    // deque: it takes its newest task from the back and, once that runs dry, steals the oldest
+    // task from the front of another worker's deque, so long jobs do not leave threads idle.
+    // Unlike ThreadPool the calling thread does not run tasks, it only waits for them.
+    class WorkStealingPool {
+    public:
+        explicit WorkStealingPool(int threads) {
+            if (threads <= 0) {
+                throw std::invalid_argument("Thread count must be positive");
+            }
+            for (int i = 0; i < threads; ++i) {
+                queues_.push_back(std::make_unique<Queue>());
+            }
+            for (int i = 0; i < threads; ++i) {
+                workers_.emplace_back([this, i] { workerLoop(i); });
+            }
+        }
+
+        WorkStealingPool(const WorkStealingPool&) = delete;
+        WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+        ~WorkStealingPool() {
+            {
+                std::lock_guard lock(mutex_);
+                stop_ = true;
+            }
+            wake_.notify_all();
+            for (auto &worker : workers_) {
+                worker.join();
+            }
+        }
+
+        int size() const {
+            return int(workers_.size());
+        }
+
+        // Queues tasks round-robin over the workers
+        void submit(std::function<void()> task) {
+            Queue &queue = *queues_[next_++ % queues_.size()];
+            {
+                std::lock_guard lock(queue.mutex);
+                queue.tasks.push_back(std::move(task));
+            }
+            {
+                std::lock_guard lock(mutex_);
+                ++queued_;
+                ++unfinished_;
+            }
+            wake_.notify_one();
+        }
+
+        // Blocks until every submitted task has finished
+        void wait() {
+            std::unique_lock lock(mutex_);
+            idle_.wait(lock, [this] { return unfinished_ == 0; });
+        }
+
+    private:
+        struct Queue {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        std::optional<std::function<void()>> take(int self) {
+            {
+                Queue &own = *queues_[self];
+                std::lock_guard lock(own.mutex);
+                if (!own.tasks.empty()) {
+                    auto task = std::move(own.tasks.back());
+                    own.tasks.pop_back();
+                    return task;
+                }
+            }
+            for (size_t i = 1; i < queues_.size(); ++i) {
+                Queue &victim = *queues_[(self + i) % queues_.size()];
+                std::lock_guard lock(victim.mutex);
+                if (!victim.tasks.empty()) {
+                    auto task = std::move(victim.tasks.front());
+                    victim.tasks.pop_front();
+                    return task;
+                }
+            }
+            return std::nullopt;
+        }
+
+        void workerLoop(int self) {
+            while (true) {
+                {
+                    std::unique_lock lock(mutex_);
+                    wake_.wait(lock, [this] { return stop_ || queued_ > 0; });
+                    if (stop_) {
+                        return;
+                    }
+                    // claim one queued task; another claimant may grab the one we would have
+                    // found first, but a task for every claim stays in some deque
+                    --queued_;
+                }
+                std::optional<std::function<void()>> task;
+                while (!(task = take(self))) {
+                    std::this_thread::yield();
+                }
+                (*task)();
+                {
+                    std::lock_guard lock(mutex_);
+                    --unfinished_;
+                    if (unfinished_ == 0) {
+                        idle_.notify_all();
+                    }
+                }
+            }
+        }
+
+        std::vector<std::unique_ptr<Queue>> queues_;
+        std::vector<std::thread> workers_;
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::condition_variable idle_;
+        size_t next_ = 0;
+        size_t queued_ = 0;
+        size_t unfinished_ = 0;
+        bool stop_ = false;
+    };
+
+}
+
+#endif //FLUIDFINALVER_WORKSTEALINGPOOL_H